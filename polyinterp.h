@@ -9,24 +9,119 @@
 // Points with abscissae closer than the minimum threshold merge
 // at the arithmetic mean.
 
+#pragma once
+
 extern "C" {
 #include "slatec_polint.h"
 #include "slatec_polyvl.h"
 }
 
+#include "polyinterp_trace.h"
+
 #ifdef __cplusplus
 
 #include <functional>
 #include <limits>
+#include <type_traits>
 #include <vector>
 
+// Does any lane of a difference vanish?  Plain arithmetic scalars
+// compare to a bool.  Vector scalars, std::experimental::simd for
+// one, compare to a mask; reduce the mask using any_of() found by
+// argument-dependent lookup.  Vector types of your own need only
+// provide an any_of() overload for their mask type.
+template <typename Scalar>
+inline bool polint_any_zero(const Scalar &dif) {
+  if constexpr (std::is_convertible_v<decltype(dif == Scalar(0)), bool>)
+    return dif == Scalar(0);
+  else
+    return any_of(dif == Scalar(0));
+}
+
+// Generic polynomial interpolation for any arithmetic-like Scalar.
+// Vector scalars fit their lanes independently, one problem per lane.
+// Fails if any lane has coincident abscissae.
 template <typename Scalar>
 enum slatec_polint_status polint(size_t n, const Scalar x[], const Scalar y[],
-                                 Scalar c[]);
+                                 Scalar c[]) {
+  if (n == 0)
+    return slatec_polint_failure;
+  c[0] = y[0];
+  if (n == 1)
+    return slatec_polint_success;
+  for (size_t k = 1; k < n; k++) {
+    c[k] = y[k];
+    for (size_t i = 0; i < k; i++) {
+      const Scalar dif = x[i] - x[k];
+      if (polint_any_zero(dif))
+        return slatec_polint_abscissae_not_distinct;
+      c[k] = (c[i] - c[k]) / dif;
+    }
+  }
+  return slatec_polint_success;
+}
 
+// Generic polynomial evaluation, lane-wise for vector scalars.
 template <typename Scalar>
 enum slatec_polyvl_status polyvl(Scalar xx, Scalar *yy, size_t n,
-                                 const Scalar x[], const Scalar c[]);
+                                 const Scalar x[], const Scalar c[]) {
+  if (n == 0)
+    return slatec_polyvl_failure;
+  Scalar pione(1), pone = c[0];
+  for (size_t k = 1; k < n; k++) {
+    pione = (xx - x[k - 1]) * pione;
+    pone = pone + pione * c[k];
+  }
+  *yy = pone;
+  return slatec_polyvl_success;
+}
+
+template <>
+inline enum slatec_polint_status polint<double>(size_t n, const double x[],
+                                                const double y[], double c[]) {
+  return slatec_polint(n, x, y, c);
+}
+
+template <>
+inline enum slatec_polyvl_status polyvl<double>(double xx, double *yy,
+                                                size_t n, const double x[],
+                                                const double c[]) {
+  return slatec_polyvl(xx, yy, n, x, c);
+}
+
+template <>
+inline enum slatec_polint_status polint<float>(size_t n, const float x[],
+                                               const float y[], float c[]) {
+  return slatec_polintf(n, x, y, c);
+}
+
+template <>
+inline enum slatec_polyvl_status polyvl<float>(float xx, float *yy, size_t n,
+                                               const float x[],
+                                               const float c[]) {
+  return slatec_polyvlf(xx, yy, n, x, c);
+}
+
+// Expands n Newton coefficients c on abscissae x into power-basis
+// coefficients a of (x - x0), the Taylor coefficients at x0.  Nested
+// multiplication, innermost first: a = c[n-1]; then a = a (x - x[k])
+// + c[k] for k from n-2 down to 0.
+template <typename Scalar>
+std::vector<Scalar> poly_horner_expand(size_t n, const Scalar x[],
+                                       const Scalar c[], Scalar x0) {
+  std::vector<Scalar> a;
+  if (n == 0)
+    return a;
+  a.push_back(c[n - 1]);
+  for (size_t k = n - 1; k-- > 0;) {
+    const Scalar d = x[k] - x0;
+    a.insert(a.begin(), 0);
+    for (size_t i = 0; i + 1 < a.size(); i++)
+      a[i] = a[i] - d * a[i + 1];
+    a[0] = a[0] + c[k];
+  }
+  return a;
+}
 
 template <typename Scalar>
 struct poly_interpolator // a unary functor
@@ -36,6 +131,8 @@ private:
   std::vector<Scalar> X, Y, C;
   std::vector<int> N;
 
+  template <typename> friend class poly_partial;
+
 public:
   poly_interpolator() : abscissaDeltaThres(0) {}
 
@@ -44,7 +141,10 @@ public:
       abscissaDeltaThres = x;
   }
 
+  Scalar abscissa_thres() const { return abscissaDeltaThres; }
+
   void add(Scalar const &x, Scalar const &y) {
+    POLYINTERP_PROBE2(add_entry, this, N.size());
     // sort x by insertion -- iterate while X[i] < x
     auto Xi = X.begin();
     for (; Xi != X.end() && *Xi < x; ++Xi)
@@ -56,10 +156,12 @@ public:
       X[i] = (x + X[i] * N[i]) / (N[i] + 1);
       Y[i] = (y + Y[i] * N[i]) / (N[i] + 1);
       ++N[i];
+      POLYINTERP_PROBE2(add_merge, this, N.size());
     } else if (Xi != X.end() && Xi[0] - x <= abscissaDeltaThres) {
       X[i] = (x + X[i] * N[i]) / (N[i] + 1);
       Y[i] = (y + Y[i] * N[i]) / (N[i] + 1);
       ++N[i];
+      POLYINTERP_PROBE2(add_merge, this, N.size());
     } else {
       // Get the dangerous bit over with!  Throwing is the worry.
       // It's fine---except half way through an add op.  Since there
@@ -82,12 +184,15 @@ public:
       Y.insert(Yi, y);
       C.insert(Ci, 0);
       N.insert(Ni, 1);
+      POLYINTERP_PROBE2(add_insert, this, N.size());
     }
   }
 
   void interpolate() {
+    POLYINTERP_PROBE2(interpolate_entry, this, N.size());
     enum slatec_polint_status status =
         polint(N.size(), X.data(), Y.data(), C.data());
+    POLYINTERP_PROBE3(interpolate_exit, this, N.size(), status);
     if (status != slatec_polint_success)
       throw status;
   }
@@ -108,6 +213,12 @@ public:
     return N.size(); // polynomial?
   }
 
+  // Read-only views of the sorted abscissae, their merged ordinates
+  // and of the Newton coefficients from the last interpolate().
+  const std::vector<Scalar> &abscissae() const { return X; }
+  const std::vector<Scalar> &ordinates() const { return Y; }
+  const std::vector<Scalar> &coefficients() const { return C; }
+
   void clear() {
     X.clear();
     Y.clear();
@@ -156,28 +267,4 @@ int main(int argc, char *argv[]) {
 
 #endif
 
-template <>
-enum slatec_polint_status polint<double>(size_t n, const double x[],
-                                         const double y[], double c[]) {
-  return slatec_polint(n, x, y, c);
-}
-
-template <>
-enum slatec_polyvl_status polyvl<double>(double xx, double *yy, size_t n,
-                                         const double x[], const double c[]) {
-  return slatec_polyvl(xx, yy, n, x, c);
-}
-
-template <>
-enum slatec_polint_status polint<float>(size_t n, const float x[],
-                                        const float y[], float c[]) {
-  return slatec_polintf(n, x, y, c);
-}
-
-template <>
-enum slatec_polyvl_status polyvl<float>(float xx, float *yy, size_t n,
-                                        const float x[], const float c[]) {
-  return slatec_polyvlf(xx, yy, n, x, c);
-}
-
 #endif // __cplusplus
@@ -0,0 +1,90 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// Reverse-mode gradients with respect to the ordinates.
+//
+// The interpolant is linear in its ordinates: p(x) = sum y[j] l[j](x)
+// for Lagrange basis polynomials l[j] of the abscissae alone.  Given
+// upstream gradients g[i] = dL/dp(x[i]) at m queries, the gradient of
+// loss L with respect to the ordinates is
+//
+//   dL/dy[j] = sum g[i] l[j](x[i])
+//
+// Rather than form the n-by-m basis, run the fit and the evaluation
+// backwards.  Evaluation p(x) = sum c[k] pi[k](x) over the Newton
+// products pi[k] gives dL/dc[k] = sum g[i] pi[k](x[i]): O(n) per
+// query.  Reversing the divided differences of polint() carries
+// dL/dc back to dL/dy once, in O(n^2).  O(n m + n^2) in all, O(n)
+// space.  The arithmetic is the transpose of the fit's, and so is its
+// conditioning: the divided differences amplify rounding alike both
+// ways.
+
+#pragma once
+
+#include "polyinterp.h"
+
+#include <vector>
+
+// Accumulates into cbar[k] the sum of g[i] pi[k](xx[i]) over m
+// queries: the adjoint of polyvl() with respect to its coefficients.
+template <typename Scalar>
+enum slatec_polyvl_status polyvl_adjoint(size_t m, const Scalar xx[],
+                                         const Scalar g[], size_t n,
+                                         const Scalar x[], Scalar cbar[]) {
+  if (n == 0)
+    return slatec_polyvl_failure;
+  for (size_t i = 0; i < m; i++) {
+    Scalar pione = g[i];
+    cbar[0] = cbar[0] + pione;
+    for (size_t k = 1; k < n; k++) {
+      pione = (xx[i] - x[k - 1]) * pione;
+      cbar[k] = cbar[k] + pione;
+    }
+  }
+  return slatec_polyvl_success;
+}
+
+// Carries coefficient gradients cbar back through polint()'s divided
+// differences to ordinate gradients ybar.  Overwrites cbar.
+template <typename Scalar>
+enum slatec_polint_status polint_adjoint(size_t n, const Scalar x[],
+                                         Scalar cbar[], Scalar ybar[]) {
+  if (n == 0)
+    return slatec_polint_failure;
+  for (size_t k = n; k-- > 1;) {
+    for (size_t i = k; i-- > 0;) {
+      const Scalar dif = x[i] - x[k];
+      if (polint_any_zero(dif))
+        return slatec_polint_abscissae_not_distinct;
+      // Forward: c[k] = (c[i] - c[k]) / dif.
+      const Scalar t = cbar[k] / dif;
+      cbar[i] = cbar[i] + t;
+      cbar[k] = -t;
+    }
+    ybar[k] = cbar[k];
+  }
+  ybar[0] = cbar[0];
+  return slatec_polint_success;
+}
+
+// Gradient of a loss with respect to poly's n() ordinates, the merged
+// ordinates() in abscissa order, given its gradients g with respect
+// to p(x) at m queries x.  Needs no interpolate(): the basis depends
+// on the abscissae alone.  Throws as interpolate() does on coincident
+// abscissae.
+template <typename Scalar>
+std::vector<Scalar>
+poly_ordinate_gradient(const poly_interpolator<Scalar> &poly, const Scalar x[],
+                       const Scalar g[], size_t m) {
+  const size_t n = poly.n();
+  std::vector<Scalar> cbar(n, Scalar(0)), ybar(n);
+  if (n == 0)
+    return ybar;
+  const Scalar *X = poly.abscissae().data();
+  polyvl_adjoint(m, x, g, n, X, cbar.data());
+  enum slatec_polint_status status =
+      polint_adjoint(n, X, cbar.data(), ybar.data());
+  if (status != slatec_polint_success)
+    throw status;
+  return ybar;
+}
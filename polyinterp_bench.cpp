@@ -0,0 +1,373 @@
+// SPDX-License-Identifier: MIT
+//
+// Accuracy-versus-throughput differential harness.
+//
+// Generates a reproducible corpus of interpolation problems, runs
+// every fit and evaluation path over each, and measures every answer
+// against a high-precision reference: the same polint/polyvl
+// templates instantiated for __float128, or long double where the
+// compiler lacks it.  Errors count units in the last place of the
+// engine's own precision at the largest reference ordinate of the
+// corpus; near an interpolant's zeros relative error means little.
+// One Pareto table results: per corpus and engine, the worst and
+// root-mean-square error beside throughput in millions of
+// evaluations per second.  A star marks the engines that no other
+// engine beats on both worst absolute error and speed.
+//
+// Usage: polyinterp_bench [-m queries] [-s seed]
+
+#include "polyinterp.h"
+#include "polyinterp_jit.h"
+#include "polyinterp_multipoint.h"
+#include "polyinterp_taylor.h"
+#include "polyinterp_timestamp.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <experimental/simd>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifdef __SIZEOF_FLOAT128__
+typedef __float128 reference_type;
+#else
+typedef long double reference_type;
+#endif
+
+////////////////////////////////////////////////////////////////////////
+// Corpus
+
+struct corpus {
+  std::string name;
+  std::vector<double> x, y; // raw points, duplicates and all
+  double thres = 0;         // abscissa merge threshold
+  double a = 0, b = 1;      // query range
+  bool integral = false;    // abscissae and queries are whole numbers
+};
+
+// SplitMix64: the same stream on every platform, unlike the standard
+// distributions.
+struct random_stream {
+  uint64_t s;
+  uint64_t next() {
+    uint64_t z = (s += 0x9e3779b97f4a7c15u);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+    return z ^ (z >> 31);
+  }
+  double uniform(double a, double b) {
+    return a + (b - a) * double(next() >> 11) * 0x1p-53;
+  }
+};
+
+static std::vector<corpus> generate(random_stream &rs) {
+  std::vector<corpus> cs;
+  {
+    corpus c{"runge", {}, {}, 0, -1, 1};
+    for (int i = 0; i < 12; i++) {
+      double x = -1 + 2.0 * i / 11;
+      c.x.push_back(x);
+      c.y.push_back(1 / (1 + 25 * x * x));
+    }
+    cs.push_back(c);
+  }
+  {
+    // The README's normalising calibration over a 16-bit ADC, plus
+    // two noisy intermediate codes.
+    corpus c{"adc", {10000, 5000, 100}, {0, 0.5, 1}, 0, 0, 65535, true};
+    for (double code : {2500.0, 7500.0}) {
+      c.x.push_back(code);
+      c.y.push_back(1 - code / 9900 + rs.uniform(-1e-3, 1e-3));
+    }
+    cs.push_back(c);
+  }
+  {
+    // Eight clusters of six repeated measurements, each cluster
+    // narrower than the merge threshold.
+    corpus c{"clustered", {}, {}, 0.01, 0, 7};
+    for (int k = 0; k < 8; k++)
+      for (int j = 0; j < 6; j++) {
+        double x = k + rs.uniform(-0.004, 0.004);
+        c.x.push_back(x);
+        c.y.push_back(std::sin(x) + rs.uniform(-1e-4, 1e-4));
+      }
+    cs.push_back(c);
+  }
+  {
+    // Whole-number abscissae far from the origin, ten million ticks
+    // out: single precision resolves them only to the nearest tick.
+    corpus c{"wide", {}, {}, 0, 1e7, 1e7 + 700, true};
+    for (int k = 0; k < 8; k++) {
+      c.x.push_back(1e7 + 100 * k);
+      c.y.push_back(std::sin(k / 3.0));
+    }
+    cs.push_back(c);
+  }
+  return cs;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Engines
+
+// An engine fitted to one corpus.  Queries convert to the engine's
+// own types before timing starts, and answers back after it ends, so
+// that the timing sees only evaluation.
+struct evaluator {
+  std::function<void()> run;                          // timed
+  std::function<void(std::vector<double> &y)> answer; // untimed
+};
+
+struct engine {
+  std::string name;
+  int digits; // mantissa bits of the engine's precision
+  // Fits corpus c for queries x; throws on fit failure; answers an
+  // empty evaluator for corpora the engine does not apply to.
+  std::function<evaluator(const corpus &c, const std::vector<double> &x)>
+      fit;
+};
+
+// Binds body(x, y, m), over queries of type Query and answers of type
+// Answer, to copies of the queries.
+template <typename Query, typename Answer, typename Body>
+static evaluator bind(const std::vector<double> &x, Body body) {
+  struct buffers {
+    std::vector<Query> x;
+    std::vector<Answer> y;
+  };
+  auto b = std::make_shared<buffers>();
+  for (double q : x)
+    b->x.push_back(Query(q));
+  b->y.resize(x.size());
+  return {[b, body] { body(b->x.data(), b->y.data(), b->x.size()); },
+          [b](std::vector<double> &y) { y.assign(b->y.begin(), b->y.end()); }};
+}
+
+template <typename Scalar, typename Interpolator>
+static Interpolator fitted(const corpus &c) {
+  Interpolator p;
+  p.set_abscissa_thres(Scalar(c.thres));
+  for (size_t i = 0; i < c.x.size(); i++)
+    p.add(Scalar(c.x[i]), Scalar(c.y[i]));
+  p.interpolate();
+  return p;
+}
+
+template <typename Scalar>
+static engine polyvl_engine(const char *name) {
+  return {name, std::numeric_limits<Scalar>::digits,
+          [](const corpus &c, const std::vector<double> &x) {
+            auto p = fitted<Scalar, poly_interpolator<Scalar>>(c);
+            return bind<Scalar, Scalar>(
+                x, [p](const Scalar *x, Scalar *y, size_t m) {
+                  for (size_t i = 0; i < m; i++)
+                    y[i] = p(x[i]);
+                });
+          }};
+}
+
+template <typename Scalar>
+static engine jit_engine(const char *name) {
+  return {name, std::numeric_limits<Scalar>::digits,
+          [](const corpus &c, const std::vector<double> &x) {
+            auto p = fitted<Scalar, poly_jit_interpolator<Scalar>>(c);
+            return bind<Scalar, Scalar>(
+                x, [p](const Scalar *x, Scalar *y, size_t m) { p(x, y, m); });
+          }};
+}
+
+// One curve broadcast across every lane of a native SIMD vector;
+// each lane evaluates its own query through the generic polyvl.
+template <typename Scalar>
+static engine simd_engine(const char *name) {
+  return {name, std::numeric_limits<Scalar>::digits,
+          [](const corpus &c, const std::vector<double> &x) {
+            namespace stdx = std::experimental;
+            typedef stdx::native_simd<Scalar> V;
+            auto p = fitted<Scalar, poly_interpolator<Scalar>>(c);
+            std::vector<V> X(p.abscissae().begin(), p.abscissae().end());
+            std::vector<V> C(p.coefficients().begin(),
+                             p.coefficients().end());
+            return bind<Scalar, Scalar>(
+                x, [X, C](const Scalar *x, Scalar *y, size_t m) {
+                  size_t i = 0;
+                  for (; i + V::size() <= m; i += V::size()) {
+                    V yy = 0;
+                    polyvl(V(x + i, stdx::element_aligned), &yy, X.size(),
+                           X.data(), C.data());
+                    yy.copy_to(y + i, stdx::element_aligned);
+                  }
+                  for (; i < m; i++) {
+                    V yy = 0;
+                    polyvl(V(x[i]), &yy, X.size(), X.data(), C.data());
+                    y[i] = yy[0];
+                  }
+                });
+          }};
+}
+
+static engine taylor_engine(const char *name) {
+  return {name, std::numeric_limits<double>::digits,
+          [](const corpus &c, const std::vector<double> &x) {
+            auto p = fitted<double, poly_interpolator<double>>(c);
+            return bind<double, double>(
+                x, [p](const double *x, double *y, size_t m) {
+                  poly_taylor_cache<double> t(p, 1e-10);
+                  for (size_t i = 0; i < m; i++)
+                    y[i] = t(x[i]);
+                });
+          }};
+}
+
+// Forces the tree path, whatever the size, to measure its basis.
+static engine multipoint_engine(const char *name) {
+  return {name, std::numeric_limits<double>::digits,
+          [](const corpus &c, const std::vector<double> &x) {
+            auto p = fitted<double, poly_interpolator<double>>(c);
+            poly_multipoint_options opts;
+            opts.crossover_n = opts.crossover_m = 0;
+            auto e =
+                std::make_shared<poly_multipoint_evaluator<double>>(p, opts);
+            return bind<double, double>(
+                x, [e](const double *x, double *y, size_t m) {
+                  (*e)(x, y, m);
+                });
+          }};
+}
+
+static engine timestamp_engine(const char *name) {
+  return {name, std::numeric_limits<float>::digits,
+          [](const corpus &c, const std::vector<double> &x) {
+            if (!c.integral)
+              return evaluator();
+            poly_timestamp_interpolator<float> p;
+            for (size_t i = 0; i < c.x.size(); i++)
+              p.add(int64_t(c.x[i]), float(c.y[i]));
+            p.interpolate();
+            return bind<int64_t, float>(
+                x, [p](const int64_t *x, float *y, size_t m) {
+                  for (size_t i = 0; i < m; i++)
+                    y[i] = p(x[i]);
+                });
+          }};
+}
+
+////////////////////////////////////////////////////////////////////////
+// Harness
+
+struct result {
+  std::string corpus, engine;
+  double max_ulp, rms_ulp, max_abs, mevals;
+  bool ok;
+};
+
+// Units in the last place of r at the given mantissa width.
+static double ulp(double r, int digits) {
+  int e;
+  std::frexp(r, &e);
+  return std::ldexp(1.0, e - digits);
+}
+
+int main(int argc, char *argv[]) {
+  size_t m = 100000;
+  uint64_t seed = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "m:s:")) != -1)
+    switch (opt) {
+    case 'm':
+      m = strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      seed = strtoull(optarg, NULL, 0);
+    }
+  random_stream rs{seed};
+  std::vector<corpus> cs = generate(rs);
+
+  std::vector<engine> es{
+      polyvl_engine<double>("polyvl<double>"),
+      polyvl_engine<float>("polyvl<float>"),
+      jit_engine<double>("jit<double>"),
+      jit_engine<float>("jit<float>"),
+      simd_engine<double>("simd<double>"),
+      simd_engine<float>("simd<float>"),
+      taylor_engine("taylor<double>"),
+      multipoint_engine("multipoint<double>"),
+      timestamp_engine("timestamp<float>"),
+  };
+
+  std::vector<result> results;
+  for (const corpus &c : cs) {
+    // Queries sweep the range slowly, as an operating point would.
+    std::vector<double> x(m), y(m);
+    for (size_t i = 0; i < m; i++) {
+      x[i] = c.a + (c.b - c.a) * double(i) / double(m);
+      if (c.integral)
+        x[i] = std::floor(x[i]);
+    }
+    auto ref = fitted<reference_type, poly_interpolator<reference_type>>(c);
+    std::vector<double> r(m);
+    double scale = 0;
+    for (size_t i = 0; i < m; i++) {
+      r[i] = double(ref(reference_type(x[i])));
+      scale = std::max(scale, std::fabs(r[i]));
+    }
+
+    for (const engine &e : es) {
+      result out{c.name, e.name, 0, 0, 0, 0, false};
+      evaluator eval;
+      try {
+        eval = e.fit(c, x);
+      } catch (...) {
+      }
+      if (eval.run) {
+        // Repeat until the timing covers a fifth of a second.
+        size_t runs = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        std::chrono::duration<double> dt{};
+        do {
+          eval.run();
+          ++runs;
+          dt = std::chrono::steady_clock::now() - t0;
+        } while (dt.count() < 0.2);
+        eval.answer(y);
+        double sum = 0;
+        for (size_t i = 0; i < m; i++) {
+          double u = std::fabs(y[i] - r[i]) / ulp(scale, e.digits);
+          if (!(u <= out.max_ulp))
+            out.max_ulp = std::isnan(u) ? HUGE_VAL : u;
+          sum += u * u;
+        }
+        out.rms_ulp = std::sqrt(sum / double(m));
+        out.max_abs = out.max_ulp * ulp(scale, e.digits);
+        out.mevals = double(runs * m) / dt.count() / 1e6;
+        out.ok = true;
+      }
+      results.push_back(out);
+    }
+  }
+
+  printf("%-10s %-20s %10s %10s %10s %10s\n", "corpus", "engine", "max ulp",
+         "rms ulp", "max abs", "Meval/s");
+  for (const result &a : results) {
+    if (!a.ok) {
+      printf("%-10s %-20s %10s %10s %10s %10s\n", a.corpus.c_str(),
+             a.engine.c_str(), "-", "-", "-", "-");
+      continue;
+    }
+    bool dominated = false;
+    for (const result &b : results)
+      if (b.ok && &b != &a && b.corpus == a.corpus &&
+          b.max_abs <= a.max_abs && b.mevals >= a.mevals &&
+          (b.max_abs < a.max_abs || b.mevals > a.mevals))
+        dominated = true;
+    printf("%-10s %-20s %10.3g %10.3g %10.3g %10.1f%s\n", a.corpus.c_str(),
+           a.engine.c_str(), a.max_ulp, a.rms_ulp, a.max_abs, a.mevals,
+           dominated ? "" : " *");
+  }
+  return EXIT_SUCCESS;
+}
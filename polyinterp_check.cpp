@@ -0,0 +1,655 @@
+// SPDX-License-Identifier: MIT
+//
+// In-tree checks.
+//
+// Includes every header, so that each at least compiles, and
+// exercises each on small problems with known answers.  Prints one
+// line per failed check and exits non-zero if any failed; ctest runs
+// it.  Run from a writable directory: some checks write scratch
+// files there, and remove them when done.
+//
+// Usage: polyinterp_check
+
+#include "polyinterp.h"
+#include "polyinterp_adjoint.h"
+#include "polyinterp_codegen.h"
+#include "polyinterp_jit.h"
+#include "polyinterp_lod.h"
+#include "polyinterp_multipoint.h"
+#include "polyinterp_numa.h"
+#include "polyinterp_partial.h"
+#include "polyinterp_planner.h"
+#include "polyinterp_record.h"
+#include "polyinterp_roots.h"
+#include "polyinterp_scheduler.h"
+#include "polyinterp_shadow.h"
+#include "polyinterp_shared.h"
+#include "polyinterp_taylor.h"
+#include "polyinterp_tiered.h"
+#include "polyinterp_timestamp.h"
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <experimental/simd>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);    \
+      ++failures;                                                              \
+    }                                                                          \
+  } while (0)
+
+// Runge's function at n equispaced points on [-1, 1].
+static poly_interpolator<double> runge(size_t n) {
+  poly_interpolator<double> p;
+  for (size_t i = 0; i < n; i++) {
+    const double x = -1 + 2 * double(i) / double(n - 1);
+    p.add(x, 1 / (1 + 25 * x * x));
+  }
+  p.interpolate();
+  return p;
+}
+
+static double polyvl_at(const poly_interpolator<double> &p, double x) {
+  double y = 0;
+  polyvl(x, &y, p.n(), p.abscissae().data(), p.coefficients().data());
+  return y;
+}
+
+static void check_adjoint() {
+  // The fit is linear in its ordinates: the gradient of p(x) with
+  // respect to y[j] is the change in p(x) when y[j] grows by one.
+  poly_interpolator<double> p = runge(7);
+  const double x[] = {-0.9, -0.2, 0.35, 0.8};
+  const double g[] = {1, 1, 1, 1};
+  const std::vector<double> ybar = poly_ordinate_gradient(p, x, g, 4);
+  CHECK(ybar.size() == 7);
+  for (size_t j = 0; j < p.n(); j++) {
+    poly_interpolator<double> q;
+    for (size_t k = 0; k < p.n(); k++)
+      q.add(p.abscissae()[k], p.ordinates()[k] + (k == j ? 1 : 0));
+    q.interpolate();
+    double d = 0;
+    for (double xi : x)
+      d += q(xi) - p(xi);
+    CHECK(std::fabs(ybar[j] - d) <= 1e-9);
+  }
+}
+
+static void check_codegen() {
+  poly_interpolator<double> adc;
+  adc.add(100, 1);
+  adc.add(5000, 0.5);
+  adc.add(10000, 0);
+  adc.interpolate();
+
+  poly_codegen_options opts;
+  std::ostringstream out;
+  CHECK(poly_codegen(out, adc, opts) == poly_codegen_success);
+  CHECK(out.str().find("0x") != std::string::npos);
+
+  // C++ before C++17 has no hexadecimal floating literals.
+  opts.language = poly_codegen_cxx;
+  out.str("");
+  CHECK(poly_codegen(out, adc, opts) == poly_codegen_success);
+  CHECK(out.str().find("0x") == std::string::npos);
+
+  // Q16 cannot hold the ADC's products or its small coefficients.
+  opts.fixed_point_bits = 16;
+  out.str("");
+  CHECK(poly_codegen(out, adc, opts) == poly_codegen_fixed_point_overflow);
+  opts.form = poly_codegen_horner;
+  out.str("");
+  CHECK(poly_codegen(out, adc, opts) != poly_codegen_success);
+
+  // But it holds a parabola on the unit interval.
+  poly_interpolator<double> unit;
+  unit.add(0, 0);
+  unit.add(0.5, 0.25);
+  unit.add(1, 1);
+  unit.interpolate();
+  for (poly_codegen_form form : {poly_codegen_newton, poly_codegen_horner}) {
+    opts.form = form;
+    out.str("");
+    CHECK(poly_codegen(out, unit, opts) == poly_codegen_success);
+  }
+}
+
+static void check_jit() {
+  // Bit for bit with polyvl(), compiled or not.
+  poly_jit_interpolator<double> j;
+  poly_interpolator<double> p = runge(12);
+  for (size_t i = 0; i < p.n(); i++)
+    j.add(p.abscissae()[i], p.ordinates()[i]);
+  j.interpolate();
+  std::vector<double> x(37), y(37);
+  for (size_t i = 0; i < x.size(); i++)
+    x[i] = -1 + 2 * double(i) / double(x.size() - 1);
+  j(x.data(), y.data(), x.size());
+  for (size_t i = 0; i < x.size(); i++) {
+    CHECK(j(x[i]) == polyvl_at(p, x[i]));
+    CHECK(y[i] == polyvl_at(p, x[i]));
+  }
+}
+
+static void check_lod() {
+  poly_lod_interpolator<double> lod;
+  lod.set_abscissa_thres(0.01);
+  for (int i = 0; i < 40; i++) {
+    const double x = -1 + 2 * i / 39.0;
+    lod.add(x, std::sin(x));
+  }
+  lod.interpolate();
+  CHECK(lod.levels() > 1);
+  CHECK(lod.error(0) == 0);
+  for (size_t k = 1; k < lod.levels(); k++)
+    CHECK(lod.level(k).n() < lod.level(k - 1).n());
+  CHECK(lod.select(0) == 0);
+  CHECK(lod.select(HUGE_VAL) == lod.levels() - 1);
+  CHECK(std::fabs(lod(0.3) - std::sin(0.3)) <= 1e-9);
+}
+
+static void check_multipoint() {
+  // Chebyshev points keep the fit well conditioned at any size; the
+  // Newton form in sorted order loses it all by a hundred of them.
+  const size_t m = 2000;
+  std::vector<double> x(m), y(m);
+  for (size_t i = 0; i < m; i++)
+    x[i] = -0.99 + 1.98 * double(i) / double(m - 1);
+  for (size_t n : {20, 100, 600}) {
+    poly_interpolator<double> p;
+    for (size_t i = 0; i < n; i++) {
+      const double t = std::cos(M_PI * (double(i) + 0.5) / double(n));
+      p.add(t, std::exp(t));
+    }
+    p.interpolate();
+    poly_multipoint_evaluator<double> e(p);
+    const poly_multipoint_diagnostics d = e(x.data(), y.data(), m);
+    for (size_t i = 0; i < m; i += 97)
+      CHECK(std::fabs(y[i] - std::exp(x[i])) <= 1e-13);
+    // Exact sums check nothing and claim no error; the tree and
+    // polyvl() report what their probes found.
+    if (d.exact)
+      CHECK(d.probes == 0 && std::isnan(d.max_abs_err));
+    else
+      CHECK(d.probes > 0 && d.max_rel_err <= 1e-13);
+    CHECK(d.fast == (n == 600) && d.exact == (n == 100));
+
+    // Options per evaluator: this one takes the tree at any size,
+    // and others keep the defaults.
+    poly_multipoint_options tree;
+    tree.crossover_n = tree.crossover_m = 0;
+    CHECK(poly_multipoint_evaluator<double>(p, tree)(x.data(), y.data(), m)
+              .fast);
+    CHECK(e(x.data(), y.data(), m).fast == (n == 600));
+  }
+}
+
+static void check_numa() {
+  // Sparse node numbers, and a node without CPUs.
+  const std::string root = "polyinterp_check.numa";
+  const char *files[][2] = {{"has_cpu", "0,2-3\n"},
+                            {"node0/cpulist", "0-1\n"},
+                            {"node2/cpulist", "2-3,6\n"},
+                            {"node3/cpulist", "\n"}};
+  mkdir(root.c_str(), 0777);
+  for (const char *d : {"/node0", "/node2", "/node3"})
+    mkdir((root + d).c_str(), 0777);
+  for (const auto &f : files) {
+    std::FILE *out = std::fopen((root + "/" + f[0]).c_str(), "w");
+    CHECK(out != nullptr);
+    if (out != nullptr) {
+      std::fputs(f[1], out);
+      std::fclose(out);
+    }
+  }
+  poly_numa_topology t(root);
+  CHECK(t.nodes() == 2);
+  CHECK(t.nodes() == 2 && t.node_id(0) == 0 && t.node_id(1) == 2);
+  CHECK(t.nodes() == 2 && t.node_cpus(1) == std::vector<int>({2, 3, 6}));
+
+  poly_numa_catalog<double> catalog;
+  CHECK(catalog.local(0) == nullptr);
+  catalog.update(0, runge(5));
+  for (size_t node = 0; node < catalog.nodes(); node++)
+    CHECK(catalog.on(node, 0) && (*catalog.on(node, 0))(0.0) == 1.0);
+  CHECK(catalog.local(0) != nullptr);
+
+  for (const auto &f : files)
+    std::remove((root + "/" + f[0]).c_str());
+  for (const char *d : {"/node0", "/node2", "/node3", ""})
+    rmdir((root + d).c_str());
+}
+
+
+static void check_partial() {
+  // Serial add() and a serially filled partial agree exactly.
+  const double thres = 0.05;
+  std::vector<double> xs, ys;
+  uint64_t s = 7;
+  for (int i = 0; i < 2000; i++) {
+    s = s * 6364136223846793005u + 1442695040888963407u;
+    xs.push_back(double(s >> 54) / 1024.0);
+    ys.push_back(std::sin(3 * xs.back()));
+  }
+  poly_interpolator<double> serial;
+  serial.set_abscissa_thres(thres);
+  poly_partial<double> whole(thres);
+  for (size_t i = 0; i < xs.size(); i++) {
+    serial.add(xs[i], ys[i]);
+    whole.add(xs[i], ys[i]);
+  }
+  const poly_interpolator<double> fit = whole.interpolate();
+  CHECK(fit.n() == serial.n());
+  for (size_t i = 0; i < fit.n() && i < serial.n(); i++)
+    CHECK(std::fabs(fit.abscissae()[i] - serial.abscissae()[i]) <= 1e-12);
+
+  // Merging in points that merge nothing among themselves is adding
+  // them, in ascending order.
+  poly_partial<double> a(thres), b(thres);
+  poly_interpolator<double> ab;
+  ab.set_abscissa_thres(thres);
+  for (size_t i = 0; i < 500; i++) {
+    a.add(xs[i], ys[i]);
+    ab.add(xs[i], ys[i]);
+  }
+  for (int k = 0; k < 10; k++) {
+    b.add(0.013 + 0.1 * k, k);
+    ab.add(0.013 + 0.1 * k, k);
+  }
+  a.merge(b);
+  CHECK(a.n() == ab.n());
+  CHECK(a.count() == 510);
+  const poly_interpolator<double> merged = a.interpolate();
+  for (size_t i = 0; i < merged.n() && i < ab.n(); i++) {
+    CHECK(std::fabs(merged.abscissae()[i] - ab.abscissae()[i]) <= 1e-12);
+    CHECK(std::fabs(merged.ordinates()[i] - ab.ordinates()[i]) <= 1e-12);
+  }
+
+  // Eight partitions: every point counted, clusters sorted, and no
+  // merge result looser than add() leaves its own.
+  std::vector<poly_partial<double>> parts(8, poly_partial<double>(thres));
+  for (size_t i = 0; i < xs.size(); i++)
+    parts[i % 8].add(xs[i], ys[i]);
+  poly_partial<double> all = poly_partial_merge(parts);
+  CHECK(all.count() == xs.size());
+  const poly_interpolator<double> tree = all.interpolate();
+  const std::vector<double> &X = tree.abscissae();
+  for (size_t i = 1; i < X.size(); i++)
+    CHECK(X[i] - X[i - 1] > thres / 4);
+  CHECK(tree.n() <= serial.n() + serial.n() / 4);
+
+  // An empty partial changes nothing.
+  poly_partial<double> before = whole;
+  whole.merge(poly_partial<double>(thres));
+  CHECK(whole.n() == before.n() && whole.count() == before.count());
+}
+
+static void check_planner() {
+  poly_interpolator<double> p = runge(24);
+  poly_query_planner<double> plan(p);
+  const size_t m = 4096;
+  std::vector<double> x(m), y(m);
+  for (size_t i = 0; i < m; i++)
+    x[i] = -1 + double((i * 7) % 16) / 8;
+  const poly_plan_diagnostics d = plan(x.data(), y.data(), m);
+  CHECK(d.planned);
+  CHECK(d.unique == 16);
+  for (size_t i = 0; i < m; i++)
+    CHECK(y[i] == polyvl_at(p, x[i]));
+}
+
+static void check_polint_simd() {
+  // Four problems, one per lane: each lane fits and evaluates as the
+  // scalar routines do on that lane's points.
+  typedef std::experimental::fixed_size_simd<double, 4> vec;
+  const size_t n = 6;
+  vec x[n], y[n], c[n];
+  double xs[4][n], ys[4][n], cs[4][n];
+  for (size_t i = 0; i < n; i++)
+    for (size_t l = 0; l < 4; l++) {
+      xs[l][i] = double(i) + 0.25 * double(l) - 0.1 * double(i * i % 5);
+      ys[l][i] = std::cos(xs[l][i]) + double(l);
+      x[i][l] = xs[l][i];
+      y[i][l] = ys[l][i];
+    }
+  CHECK(polint(n, x, y, c) == slatec_polint_success);
+  vec at([](size_t l) { return 0.3 + double(l); }), yy;
+  CHECK(polyvl(at, &yy, n, x, c) == slatec_polyvl_success);
+  for (size_t l = 0; l < 4; l++) {
+    CHECK(polint(n, xs[l], ys[l], cs[l]) == slatec_polint_success);
+    for (size_t i = 0; i < n; i++)
+      CHECK(std::fabs(c[i][l] - cs[l][i]) <= 1e-12 * std::fabs(cs[l][i]));
+    double y1 = 0;
+    polyvl(0.3 + double(l), &y1, n, xs[l], cs[l]);
+    CHECK(std::fabs(yy[l] - y1) <= 1e-12);
+  }
+
+  // Coincident abscissae in one lane fail the whole fit.
+  x[4][2] = x[1][2];
+  CHECK(polint(n, x, y, c) == slatec_polint_abscissae_not_distinct);
+}
+
+static void check_probes() {
+  // Every probe on the fit path leaves its note in this executable:
+  // provider and name, nul-terminated, as tracers look them up.
+  if (!POLYINTERP_PROBES)
+    return;
+  std::ifstream in("/proc/self/exe", std::ios::binary);
+  if (!in)
+    return;
+  std::ostringstream image;
+  image << in.rdbuf();
+  const std::string notes = image.str();
+  for (const char *name : {"add_entry", "add_merge", "add_insert",
+                           "interpolate_entry", "interpolate_exit"}) {
+    const std::string key = std::string("polyinterp") + '\0' + name + '\0';
+    CHECK(notes.find(key) != std::string::npos);
+  }
+}
+
+static void check_record() {
+  const char *path = "polyinterp_check.trc";
+  {
+    poly_trace_recorder recorder(path, 64);
+    poly_recorded_interpolator<double> p(recorder);
+    p.add(0, 1);
+    p.add(1, 3);
+    p.interpolate();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+      threads.emplace_back([&p] {
+        for (int i = 0; i < 1000; i++)
+          p(i / 1000.0);
+      });
+    for (std::thread &t : threads)
+      t.join();
+    CHECK(recorder.flush());
+    CHECK(poly_trace_recorder::live_buffers() == 1);
+  }
+  // Gone with the recorder, though this thread lives on.
+  CHECK(poly_trace_recorder::live_buffers() == 0);
+  const std::vector<poly_trace_record> trace = poly_trace_recorder::load(path);
+  CHECK(trace.size() == 4 + 4000);
+  CHECK(!trace.empty() && trace[0].op == poly_trace_create);
+  for (size_t i = 1; i < trace.size(); i++)
+    CHECK(trace[i - 1].time <= trace[i].time);
+  size_t evaluations = 0;
+  for (const poly_trace_record &r : trace)
+    if (r.op == poly_trace_evaluate) {
+      ++evaluations;
+      CHECK(r.y == 1 + 2 * r.x);
+    }
+  CHECK(evaluations == 4000);
+
+  // Records must name instances created earlier in the trace.
+  for (uint32_t id : {1u, 4000000000u}) {
+    std::FILE *out = std::fopen(path, "wb");
+    CHECK(out != nullptr);
+    if (out == nullptr)
+      break;
+    poly_trace_record r[2] = {trace[0], trace[0]};
+    r[1].op = poly_trace_add;
+    r[1].id = id;
+    std::fwrite(poly_trace_magic, sizeof poly_trace_magic, 1, out);
+    std::fwrite(r, sizeof r, 1, out);
+    std::fclose(out);
+    bool thrown = false;
+    try {
+      poly_trace_recorder::load(path);
+    } catch (poly_trace_status status) {
+      thrown = status == poly_trace_bad_format;
+    }
+    CHECK(thrown);
+  }
+  std::remove(path);
+}
+
+static void check_roots() {
+  // (x - 0.5)(x + 0.5), through three points.
+  poly_interpolator<double> p;
+  for (double x : {-1.0, 0.0, 1.0})
+    p.add(x, x * x - 0.25);
+  p.interpolate();
+  std::vector<double> r = poly_roots(p, -2.0, 2.0);
+  CHECK(r.size() == 2);
+  CHECK(r.size() == 2 && std::fabs(r[0] + 0.5) <= 1e-12 &&
+        std::fabs(r[1] - 0.5) <= 1e-12);
+  CHECK(poly_roots(p, -2.0, 2.0, -1.0).empty());
+  const double levels[] = {0.75, 3.75};
+  const auto crossings = poly_roots(p, -2.0, 2.0, levels, 2);
+  CHECK(crossings[0].size() == 2 && crossings[1].size() == 2);
+  CHECK(crossings[1].size() == 2 && std::fabs(crossings[1][1] - 2) <= 1e-12);
+}
+
+static void check_scheduler() {
+  typedef poly_refit_scheduler<double> scheduler;
+  // No tick falls due during the check: flush() alone fits, taking
+  // the whole backlog as one batch.
+  scheduler s(1, std::chrono::hours(1), scheduler::clock::duration(0));
+  std::mutex mutex;
+  std::vector<size_t> order;
+  s.on_publish([&](size_t id, const scheduler::snapshot_type &) {
+    std::lock_guard<std::mutex> lock(mutex);
+    order.push_back(id);
+  });
+  // The low priority's deadline comes first; the high priority wins.
+  const size_t low = s.enroll(0, std::chrono::milliseconds(1), 0);
+  const size_t high = s.enroll(0, std::chrono::seconds(10), 1);
+  CHECK(s.snapshot(high)->n() == 0);
+  for (int i = 0; i < 8; i++) {
+    s.add(low, i, i);
+    s.add(high, i, i * i);
+  }
+  s.flush();
+  CHECK(s.snapshot(low)->n() == 8);
+  CHECK(s.snapshot(high)->n() == 8);
+  CHECK(std::fabs((*s.snapshot(high))(10.0) - 100) <= 1e-9);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    CHECK(order == std::vector<size_t>({high, low}));
+  }
+  const scheduler::metrics m = s.statistics();
+  CHECK(m.refits == 2 && m.backlog == 0 && m.failures == 0);
+}
+
+static void check_shadow() {
+  std::atomic<size_t> breaches{0};
+  poly_interpolator<float> p;
+  p.add(0, 0);
+  p.add(1, 2);
+  p.interpolate();
+  {
+    poly_shadow_monitor monitor(
+        1, 1e-3, [&](size_t, double, double, double) { ++breaches; });
+    const size_t id = monitor.watch(p);
+    for (int i = 0; i < 10; i++)
+      monitor.observe(id, i / 10.0, p(i / 10.0f));
+    monitor.observe(id, 0.5, 1.5);
+  }
+  CHECK(breaches == 1);
+}
+
+static void check_shared() {
+  poly_shared_interpolator<double> a(runge(5)), b = a;
+  CHECK(a.sharing() && b.sharing());
+  b.add(2, 0);
+  b.interpolate();
+  CHECK(!a.sharing() && a.n() == 5 && b.n() == 6);
+  CHECK(a(0.0) == 1.0);
+}
+
+static void check_taylor() {
+  poly_interpolator<double> p = runge(12);
+  poly_taylor_cache<double> t(p, 1e-10);
+  double worst = 0;
+  // A slow sweep, as an operating point would move.
+  for (int i = 0; i < 100000; i++) {
+    const double x = -1 + 2 * i / 100000.0;
+    worst = std::max(worst, std::fabs(t(x) - polyvl_at(p, x)));
+  }
+  CHECK(worst <= 2e-10);
+  CHECK(t.hits() > t.misses());
+
+  // Jitter about a fixed operating point, narrower and wider than the
+  // patch: the patch settles on the operating point and serves every
+  // query that falls inside it.
+  uint64_t s = 1;
+  for (double wide : {0.75, 1.0, 2.0}) {
+    poly_taylor_cache<double> j(p, 1e-10);
+    for (int i = 0; i < 8; i++)
+      j(0.5 + 1e-4 * (i % 2 ? 1 : -1));
+    const double r = j.patch_radius();
+    for (int i = 0; i < 20000; i++) {
+      s = s * 6364136223846793005u + 1442695040888963407u;
+      const double x = 0.5 + wide * r * (double(s >> 11) / 0x1p52 - 1);
+      worst = std::max(worst, std::fabs(j(x) - polyvl_at(p, x)));
+    }
+    CHECK(std::fabs(j.centre() - 0.5) <= 2 * r);
+    CHECK(double(j.hits()) >= 0.9 * 20000 / std::max(wide, 1.0));
+  }
+
+  // One miss moves the patch when asked to.
+  poly_taylor_cache<double> once(p, 1e-10, 4, 1);
+  once(0.25);
+  once(0.25);
+  CHECK(once.centre() == 0.25 && once.hits() == 1);
+  CHECK(worst <= 2e-10);
+
+  // Scattered queries: served exactly, and never move the patch far.
+  poly_taylor_cache<double> u(runge(40), 1e-10);
+  const poly_interpolator<double> q = runge(40);
+  for (int i = 0; i < 2000; i++) {
+    s = s * 6364136223846793005u + 1442695040888963407u;
+    const double x = -1 + double(s >> 11) / 4503599627370496.0;
+    worst = std::max(worst, std::fabs(u(x) - polyvl_at(q, x)));
+  }
+  CHECK(worst <= 2e-10);
+}
+
+static void check_tiered() {
+  poly_tiered_store<double> store(1024, "polyinterp_check.cold");
+  std::vector<size_t> ids;
+  for (size_t n = 2; n < 40; n++)
+    ids.push_back(store.insert(runge(n)));
+  for (size_t k = 0; k < 3; k++)
+    for (size_t i = 0; i < ids.size(); i++) {
+      const poly_interpolator<double> p = runge(i + 2);
+      CHECK(store(ids[i], 0.3) == polyvl_at(p, 0.3));
+    }
+  const poly_tiered_store<double>::stats s = store.statistics();
+  CHECK(s.interpolators == ids.size());
+  CHECK(s.resident_bytes <= 1024 || s.resident == 1);
+  CHECK(s.misses > 0 && s.evictions > 0 && s.cold_bytes > 0);
+  CHECK(s.metadata_bytes > 0);
+  bool thrown = false;
+  try {
+    store.acquire(ids.size());
+  } catch (poly_tiered_status status) {
+    thrown = status == poly_tiered_no_such_id;
+  }
+  CHECK(thrown);
+  std::remove("polyinterp_check.cold");
+
+  // Concurrent hits: every reader served exactly, every hit counted.
+  poly_tiered_store<double> shared(1 << 20);
+  const size_t hot = shared.insert(runge(9));
+  std::vector<std::thread> readers;
+  std::atomic<size_t> wrong{0};
+  for (int t = 0; t < 4; t++)
+    readers.emplace_back([&] {
+      for (int i = 0; i < 10000; i++)
+        if (shared(hot, 0.3) != polyvl_at(runge(9), 0.3))
+          ++wrong;
+    });
+  for (std::thread &t : readers)
+    t.join();
+  CHECK(wrong == 0);
+  CHECK(shared.statistics().hits == 40000);
+
+  // An insert whose eviction cannot write rolls back whole.
+  std::unique_ptr<poly_tiered_store<double>> full;
+  try {
+    full.reset(new poly_tiered_store<double>(64, "/dev/full"));
+  } catch (poly_tiered_status) {
+    return; // no such device here
+  }
+  const size_t first = full->insert(runge(3));
+  thrown = false;
+  try {
+    full->insert(runge(4));
+  } catch (poly_tiered_status status) {
+    thrown = status == poly_tiered_io_error;
+  }
+  CHECK(thrown);
+  const poly_tiered_store<double>::stats f = full->statistics();
+  CHECK(f.interpolators == 1 && f.resident == 1 && f.evictions == 0);
+  CHECK((*full)(first, 0.3) == polyvl_at(runge(3), 0.3));
+}
+
+
+static void check_timestamp() {
+  // Nanosecond timestamps far beyond double's integer range.
+  const int64_t epoch = 1700000000000000000;
+  poly_timestamp_interpolator<float> p;
+  for (int k = 0; k < 5; k++)
+    p.add(epoch + int64_t(k) * 1000000000, float(k * k));
+  p.interpolate();
+  CHECK(std::fabs(p(epoch + 2500000000) - 6.25f) <= 1e-4f);
+
+  // Merging compares against exact means, not whole ticks: a point
+  // meaning epoch + 1/2 lies 3/2 ticks from either neighbour.
+  poly_timestamp_interpolator<double> q;
+  q.set_abscissa_thres(1);
+  q.add(epoch, 0);
+  q.add(epoch + 1, 2);
+  CHECK(q.n() == 1);
+  q.add(epoch - 1, 5);
+  q.add(epoch + 2, 5);
+  CHECK(q.n() == 3);
+  q.interpolate();
+  CHECK(std::fabs(q(epoch) - 13.0 / 9) <= 1e-12);
+}
+
+int main() {
+  check_adjoint();
+  check_codegen();
+  check_jit();
+  check_lod();
+  check_multipoint();
+  check_numa();
+  check_partial();
+  check_planner();
+  check_polint_simd();
+  check_probes();
+  check_record();
+  check_roots();
+  check_scheduler();
+  check_shadow();
+  check_shared();
+  check_taylor();
+  check_tiered();
+  check_timestamp();
+  if (failures != 0)
+    std::printf("%d checks failed\n", failures);
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,217 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// Source code generator for fitted polynomial interpolators.
+//
+// Operation poly_codegen(os,poly,opts) writes a self-contained C99 or
+// C++ function that evaluates the fitted polynomial.  Abscissae and
+// coefficients appear as literal constants that survive the round
+// trip exactly: hexadecimal in C99, and in C++, which lacks them
+// before C++17, decimal to 17 or 9 significant digits.  The degree
+// unrolls fully.
+// The compiler can fold the constants and inline the evaluation
+// directly into a control loop.
+//
+// Two forms exist.  The Newton form repeats slatec_polyvl() operation
+// for operation.  The Horner form first expands the Newton form into
+// powers of (x - x0) where x0 centres the abscissae; one multiply-add
+// per term.  Either form optionally runs in signed fixed-point
+// arithmetic: Q-format 32-bit values with 64-bit intermediate
+// products.  An optional batch function loops over arrays with
+// restrict-qualified pointers for the compiler to vectorise.
+//
+// Fixed point loses range and precision quickly: products of
+// abscissa differences outgrow 32 bits, small coefficients round to
+// nothing.  The generator therefore runs the fixed-point arithmetic
+// it emits over the abscissae, the midpoints between them and so the
+// whole span, and reports overflow of any intermediate, or an error
+// against the floating-point fit beyond tolerance.  It still writes
+// the code; the status says whether to trust it.
+
+#pragma once
+
+#include "polyinterp.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+enum poly_codegen_language { poly_codegen_c99, poly_codegen_cxx };
+
+enum poly_codegen_form { poly_codegen_newton, poly_codegen_horner };
+
+enum poly_codegen_status {
+  poly_codegen_success,
+  poly_codegen_bad_option = -1,
+  poly_codegen_fixed_point_overflow = -2,
+  poly_codegen_fixed_point_precision_loss = -3
+};
+
+struct poly_codegen_options {
+  std::string name = "poly";
+  poly_codegen_language language = poly_codegen_c99;
+  poly_codegen_form form = poly_codegen_newton;
+  int fixed_point_bits = 0; // fraction bits, 1 to 30; 0 for floating point
+  bool batch = false;       // also emit name_batch(x,y,n)
+  // Largest fixed-point error accepted over the abscissa span; zero
+  // for n units in the last place.
+  double fixed_point_tolerance = 0;
+};
+
+template <typename Scalar>
+enum poly_codegen_status poly_codegen(std::ostream &os,
+                                      const poly_interpolator<Scalar> &poly,
+                                      const poly_codegen_options &opts = {}) {
+  static_assert(std::is_same_v<Scalar, float> ||
+                    std::is_same_v<Scalar, double>,
+                "code generation supports float and double only");
+  const int q = opts.fixed_point_bits;
+  if (opts.name.empty() || q < 0 || q > 30)
+    return poly_codegen_bad_option;
+
+  const size_t n = poly.n();
+  const Scalar *x = poly.abscissae().data();
+  const Scalar *c = poly.coefficients().data();
+  const Scalar x0 = n == 0 ? 0 : (x[0] + x[n - 1]) / 2;
+  std::vector<Scalar> a;
+  if (opts.form == poly_codegen_horner)
+    a = poly_horner_expand(n, x, c, x0);
+
+  const bool cxx = opts.language == poly_codegen_cxx;
+  const char *type = q ? (cxx ? "std::int32_t" : "int32_t")
+                       : std::is_same_v<Scalar, float> ? "float"
+                                                       : "double";
+  const char *wide = cxx ? "std::int64_t" : "int64_t";
+  const std::string &f = opts.name;
+
+  // Q-format value of v, rounded; zero if out of range, recording
+  // overflow.
+  bool overflow = false;
+  auto fixed = [&](double v) -> int64_t {
+    const double r = std::nearbyint(std::ldexp(v, q));
+    if (!(std::fabs(r) <= INT32_MAX)) {
+      overflow = true;
+      return 0;
+    }
+    return int64_t(r);
+  };
+  // Literal constant: exact hexadecimal floating point with a decimal
+  // comment in C99, exact decimal in C++, or a Q-format integer.
+  const bool single = std::is_same_v<Scalar, float>;
+  auto literal = [&](Scalar v) {
+    char buf[64];
+    if (q)
+      std::snprintf(buf, sizeof buf, "%lld", (long long)fixed(v));
+    else if (cxx) {
+      std::snprintf(buf, sizeof buf, "%.*g", single ? 9 : 17, double(v));
+      std::string s(buf);
+      if (s.find_first_of(".einf") == std::string::npos)
+        s += ".0";
+      return single ? s + "f" : s;
+    } else
+      std::snprintf(buf, sizeof buf, "%a%s /* %.*g */", double(v),
+                    single ? "f" : "", single ? 9 : 17, double(v));
+    return std::string(buf);
+  };
+  // Product of two values, rounded back to Q format when fixed point.
+  auto mul = [&](const std::string &l, const std::string &r) {
+    return q ? f + "_mulq(" + l + ", " + r + ")" : l + " * " + r;
+  };
+
+  os << "/* Generated by poly_codegen from " << n << " interpolating point"
+     << (n == 1 ? "" : "s") << ". */\n";
+  if (cxx)
+    os << "#include <cstddef>\n#include <cstdint>\n\n";
+  else
+    os << "#include <stddef.h>\n#include <stdint.h>\n\n";
+  const char *linkage = cxx ? "inline" : "static inline";
+
+  if (q) {
+    os << linkage << " " << type << " " << f << "_mulq(" << type << " a, "
+       << type << " b) {\n"
+       << "  return (" << type << ")(((" << wide << ")a * b + ((" << wide
+       << ")1 << " << q - 1 << ")) >> " << q << ");\n"
+       << "}\n\n";
+  }
+
+  os << linkage << " " << type << " " << f << "(" << type << " x) {\n";
+  if (n == 0)
+    os << "  return x;\n";
+  else if (opts.form == poly_codegen_newton) {
+    os << "  " << type << " p = " << literal(1) << ";\n";
+    os << "  " << type << " y = " << literal(c[0]) << ";\n";
+    for (size_t k = 1; k < n; k++) {
+      os << "  p = " << mul("(x - " + literal(x[k - 1]) + ")", "p") << ";\n";
+      os << "  y = y + " << mul("p", literal(c[k])) << ";\n";
+    }
+    os << "  return y;\n";
+  } else {
+    os << "  const " << type << " t = x - " << literal(x0) << ";\n";
+    os << "  " << type << " y = " << literal(a[n - 1]) << ";\n";
+    for (size_t k = n - 1; k-- > 0;)
+      os << "  y = " << mul("y", "t") << " + " << literal(a[k]) << ";\n";
+    os << "  return y;\n";
+  }
+  os << "}\n";
+
+  if (opts.batch) {
+    const char *noalias = cxx ? "__restrict" : "restrict";
+    const char *size = cxx ? "std::size_t" : "size_t";
+    const std::string head = std::string(linkage) + " void " + f + "_batch(";
+    os << "\n"
+       << head << "const " << type << " *" << noalias << " x,\n"
+       << std::string(head.size(), ' ') << type << " *" << noalias
+       << " y, " << size << " n) {\n"
+       << "  for (" << size << " i = 0; i < n; i++)\n"
+       << "    y[i] = " << f << "(x[i]);\n"
+       << "}\n";
+  }
+  if (q && n != 0 && !overflow) {
+    // Run the emitted arithmetic, in 64 bits, over the span.
+    auto check = [&](int64_t v) {
+      if (v < INT32_MIN || v > INT32_MAX)
+        overflow = true;
+      return v;
+    };
+    auto mulq = [&](int64_t l, int64_t r) {
+      return check((l * r + (int64_t(1) << (q - 1))) >> q);
+    };
+    std::vector<double> probes;
+    for (size_t k = 0; k < n; k++) {
+      if (k != 0)
+        probes.push_back((double(x[k - 1]) + double(x[k])) / 2);
+      probes.push_back(x[k]);
+    }
+    const double tolerance = opts.fixed_point_tolerance > 0
+                                 ? opts.fixed_point_tolerance
+                                 : std::ldexp(double(n), -q);
+    bool lossy = false;
+    for (size_t i = 0; i < probes.size() && !overflow; i++) {
+      const int64_t xx = fixed(probes[i]);
+      int64_t y;
+      if (opts.form == poly_codegen_newton) {
+        int64_t p = fixed(1);
+        y = fixed(c[0]);
+        for (size_t k = 1; k < n; k++) {
+          p = mulq(check(xx - fixed(x[k - 1])), p);
+          y = check(y + mulq(p, fixed(c[k])));
+        }
+      } else {
+        const int64_t t = check(xx - fixed(x0));
+        y = fixed(a[n - 1]);
+        for (size_t k = n - 1; k-- > 0;)
+          y = check(mulq(y, t) + fixed(a[k]));
+      }
+      const double exact = double(poly(Scalar(std::ldexp(double(xx), -q))));
+      if (!(std::fabs(std::ldexp(double(y), -q) - exact) <= tolerance))
+        lossy = true;
+    }
+    if (!overflow && lossy)
+      return poly_codegen_fixed_point_precision_loss;
+  }
+  return overflow ? poly_codegen_fixed_point_overflow : poly_codegen_success;
+}
@@ -0,0 +1,307 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// Just-in-time compiled polynomial evaluators.
+//
+// Interpolation with poly_interpolator runs a loop over the abscissae
+// and coefficients at every evaluation.  For a few very hot curves,
+// compile the fitted polynomial into straight-line x86-64 machine
+// code instead: degree fully unrolled, abscissae and coefficients
+// folded in as RIP-relative constants.  Two entry points emerge:
+// a scalar SSE2 evaluator and a batch evaluator using 256-bit AVX
+// vectors.
+//
+// The emitted code performs exactly the same floating-point
+// operations in exactly the same order as slatec_polyvl(); results
+// match the reference bit for bit.
+//
+// The backend needs x86-64 Linux for executable memory.  Elsewhere,
+// or whenever compilation fails, the interpolator quietly falls back
+// to polyvl().
+
+#pragma once
+
+#include "polyinterp.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define POLYINTERP_JIT 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define POLYINTERP_JIT 0
+#endif
+
+// Executable code for one fitted polynomial.  Owns its memory
+// mapping; non-copyable.  Interpolators share compiled code by
+// shared pointer.
+template <typename Scalar>
+class poly_jit_code {
+  static_assert(std::is_same_v<Scalar, float> ||
+                    std::is_same_v<Scalar, double>,
+                "JIT supports float and double only");
+
+public:
+  typedef Scalar (*scalar_fn)(Scalar);
+  typedef void (*batch_fn)(const Scalar *, Scalar *, size_t);
+
+  // Scalar lanes per 256-bit vector.
+  static constexpr size_t lanes = 32 / sizeof(Scalar);
+
+  poly_jit_code(const poly_jit_code &) = delete;
+  poly_jit_code &operator=(const poly_jit_code &) = delete;
+
+  ~poly_jit_code() {
+#if POLYINTERP_JIT
+    if (base != nullptr)
+      munmap(base, size);
+#endif
+  }
+
+  // Compiles n abscissae x and Newton coefficients c.  Answers null
+  // if the platform cannot execute generated code.
+  static std::shared_ptr<const poly_jit_code> compile(size_t n,
+                                                      const Scalar x[],
+                                                      const Scalar c[]) {
+#if POLYINTERP_JIT
+    if (n == 0)
+      return nullptr;
+    std::shared_ptr<poly_jit_code> code(new poly_jit_code);
+    if (!code->emit(n, x, c))
+      return nullptr;
+    return code;
+#else
+    (void)n, (void)x, (void)c;
+    return nullptr;
+#endif
+  }
+
+  Scalar operator()(Scalar x) const { return scalar(x); }
+
+  // Evaluates m abscissae.  Vector code runs whole batches of lanes
+  // when the host has AVX; scalar code finishes the remainder.
+  void operator()(const Scalar x[], Scalar y[], size_t m) const {
+    size_t i = 0;
+    if (batch != nullptr) {
+      i = m - m % lanes;
+      batch(x, y, i);
+    }
+    for (; i < m; i++)
+      y[i] = scalar(x[i]);
+  }
+
+private:
+  void *base = nullptr;
+  size_t size = 0;
+  scalar_fn scalar = nullptr;
+  batch_fn batch = nullptr;
+
+  poly_jit_code() = default;
+
+#if POLYINTERP_JIT
+  // Legacy SSE prefix for scalar operations: F2 for sd, F3 for ss.
+  // VEX pp field for packed operations: 01 for pd, 00 for ps.
+  static constexpr uint8_t sse_prefix = sizeof(Scalar) == 8 ? 0xf2 : 0xf3;
+  static constexpr uint8_t vex_pp = sizeof(Scalar) == 8 ? 0x01 : 0x00;
+
+  struct assembler {
+    std::vector<uint8_t> text;
+    // Offsets of RIP-relative displacements and the constant-pool
+    // entries they address, resolved once the pool has a home.
+    std::vector<std::pair<size_t, size_t>> fixups;
+
+    void byte(uint8_t b) { text.push_back(b); }
+    void bytes(std::initializer_list<uint8_t> bs) {
+      text.insert(text.end(), bs);
+    }
+    void rel32(int32_t d) {
+      for (int i = 0; i < 4; i++)
+        byte(static_cast<uint8_t>(d >> (8 * i)));
+    }
+    void rip(uint8_t reg, size_t entry) {
+      byte(static_cast<uint8_t>(0x05 | reg << 3));
+      fixups.emplace_back(text.size(), entry);
+      rel32(0);
+    }
+    static uint8_t rr(uint8_t reg, uint8_t rm) {
+      return static_cast<uint8_t>(0xc0 | reg << 3 | rm);
+    }
+
+    // movaps/movapd xmm, xmm
+    void movap(uint8_t dst, uint8_t src) {
+      if (sizeof(Scalar) == 8)
+        byte(0x66);
+      bytes({0x0f, 0x28, rr(dst, src)});
+    }
+    // {mov,sub,mul}s{s,d} xmm, [rip + pool]
+    void sse_mem(uint8_t op, uint8_t dst, size_t entry) {
+      bytes({sse_prefix, 0x0f, op});
+      rip(dst, entry);
+    }
+    // {mul,add}s{s,d} xmm, xmm
+    void sse_reg(uint8_t op, uint8_t dst, uint8_t src) {
+      bytes({sse_prefix, 0x0f, op, rr(dst, src)});
+    }
+    // Two-byte VEX prefix, 256-bit, map 0F, registers 0 to 7 only.
+    void vex(uint8_t src1) {
+      bytes({0xc5, static_cast<uint8_t>(0x80 | (~src1 & 0x0f) << 3 | 0x04 |
+                                        vex_pp)});
+    }
+    void vex_reg(uint8_t op, uint8_t dst, uint8_t src1, uint8_t src2) {
+      vex(src1);
+      bytes({op, rr(dst, src2)});
+    }
+    void vex_mem(uint8_t op, uint8_t dst, uint8_t src1, size_t entry) {
+      vex(src1);
+      byte(op);
+      rip(dst, entry);
+    }
+  };
+
+  enum : uint8_t { mov = 0x10, add = 0x58, mul = 0x59, sub = 0x5c };
+
+  bool emit(size_t n, const Scalar x[], const Scalar c[]) {
+    // Constant pool: entry 0 holds one, entries 1 to n hold the
+    // coefficients, entries n + 1 to 2n - 1 hold the abscissae.  Each
+    // entry broadcasts its constant across a 32-byte vector so that
+    // scalar and vector code can share it.
+    const size_t one = 0;
+    auto ce = [](size_t k) { return 1 + k; };
+    auto xe = [n](size_t k) { return 1 + n + k; };
+    const size_t entries = 2 * n;
+
+    assembler a;
+
+    // Scalar evaluator: x arrives in xmm0, y leaves in xmm0.
+    //   xmm1 = x, xmm0 = p = c[0], xmm2 = pi = 1
+    //   pi = (x - x[k-1]) * pi; p = p + pi * c[k]
+    a.movap(1, 0);
+    a.sse_mem(mov, 0, ce(0));
+    a.sse_mem(mov, 2, one);
+    for (size_t k = 1; k < n; k++) {
+      a.movap(3, 1);
+      a.sse_mem(sub, 3, xe(k - 1));
+      a.sse_reg(mul, 2, 3);
+      a.movap(3, 2);
+      a.sse_mem(mul, 3, ce(k));
+      a.sse_reg(add, 0, 3);
+    }
+    a.byte(0xc3); // ret
+
+    // Batch evaluator: x in rdi, y in rsi, m in rdx, m a multiple of
+    // the lane count.
+    bool avx = __builtin_cpu_supports("avx");
+    size_t batch_at = a.text.size();
+    if (avx) {
+      const uint8_t step = static_cast<uint8_t>(lanes);
+      size_t loop = a.text.size();
+      a.bytes({0x48, 0x83, 0xfa, step}); // cmp rdx, lanes
+      a.bytes({0x0f, 0x82});             // jb done
+      size_t jb = a.text.size();
+      a.rel32(0);
+      a.vex(0);
+      a.bytes({0x10, 0x0f}); // vmovup ymm1, [rdi]
+      a.vex_mem(0x28, 0, 0, ce(0));
+      a.vex_mem(0x28, 2, 0, one);
+      for (size_t k = 1; k < n; k++) {
+        a.vex_mem(sub, 3, 1, xe(k - 1));
+        a.vex_reg(mul, 2, 2, 3);
+        a.vex_mem(mul, 4, 2, ce(k));
+        a.vex_reg(add, 0, 0, 4);
+      }
+      a.vex(0);
+      a.bytes({0x11, 0x06});             // vmovup [rsi], ymm0
+      a.bytes({0x48, 0x83, 0xc7, 0x20}); // add rdi, 32
+      a.bytes({0x48, 0x83, 0xc6, 0x20}); // add rsi, 32
+      a.bytes({0x48, 0x83, 0xea, step}); // sub rdx, lanes
+      a.byte(0xe9);                      // jmp loop
+      a.rel32(static_cast<int32_t>(loop - (a.text.size() + 4)));
+      int32_t done = static_cast<int32_t>(a.text.size() - (jb + 4));
+      std::memcpy(&a.text[jb], &done, 4);
+      a.bytes({0xc5, 0xf8, 0x77}); // vzeroupper
+      a.byte(0xc3);                // ret
+    }
+
+    size_t pool_at = (a.text.size() + 31) & ~size_t(31);
+    for (auto &f : a.fixups) {
+      int32_t d = static_cast<int32_t>(pool_at + 32 * f.second - (f.first + 4));
+      std::memcpy(&a.text[f.first], &d, 4);
+    }
+
+    long page = sysconf(_SC_PAGESIZE);
+    size = (pool_at + 32 * entries + page - 1) & ~size_t(page - 1);
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+      return false;
+    base = p;
+    auto text = static_cast<uint8_t *>(p);
+    std::memcpy(text, a.text.data(), a.text.size());
+    auto fill = [&](size_t entry, Scalar value) {
+      auto e = reinterpret_cast<Scalar *>(text + pool_at + 32 * entry);
+      for (size_t i = 0; i < lanes; i++)
+        e[i] = value;
+    };
+    fill(one, 1);
+    for (size_t k = 0; k < n; k++)
+      fill(ce(k), c[k]);
+    for (size_t k = 0; k + 1 < n; k++)
+      fill(xe(k), x[k]);
+    if (mprotect(p, size, PROT_READ | PROT_EXEC) != 0)
+      return false;
+    scalar = reinterpret_cast<scalar_fn>(text);
+    if (avx)
+      batch = reinterpret_cast<batch_fn>(text + batch_at);
+    return true;
+  }
+#endif
+};
+
+// An interpolator that compiles itself at every interpolate() and
+// thereafter evaluates using the compiled code, cached until the next
+// add() or clear().  Copies share the code.
+template <typename Scalar>
+struct poly_jit_interpolator : poly_interpolator<Scalar> {
+  typedef poly_interpolator<Scalar> base;
+
+  void add(Scalar const &x, Scalar const &y) {
+    code.reset();
+    base::add(x, y);
+  }
+
+  void interpolate() {
+    code.reset();
+    base::interpolate();
+    code = poly_jit_code<Scalar>::compile(base::n(), base::abscissae().data(),
+                                          base::coefficients().data());
+  }
+
+  void clear() {
+    code.reset();
+    base::clear();
+  }
+
+  Scalar operator()(const Scalar &x) const {
+    return code ? (*code)(x) : base::operator()(x);
+  }
+
+  void operator()(const Scalar x[], Scalar y[], size_t m) const {
+    POLYINTERP_PROBE3(batch_entry, this, base::n(), m);
+    if (code)
+      (*code)(x, y, m);
+    else
+      for (size_t i = 0; i < m; i++)
+        y[i] = base::operator()(x[i]);
+    POLYINTERP_PROBE3(batch_exit, this, base::n(), m);
+  }
+
+  bool compiled() const { return code != nullptr; }
+
+private:
+  std::shared_ptr<const poly_jit_code<Scalar>> code;
+};
@@ -0,0 +1,185 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// A level-of-detail pyramid of interpolators.
+//
+// One merge threshold gives one resolution.  A pyramid fits the same
+// samples at progressively coarser thresholds: level 0 at the
+// threshold set, as a poly_interpolator would; each further level at
+// a threshold some factor coarser, so that more points merge at
+// their means and the degree falls.  Levels stop when too few points
+// remain.  Thresholds that merge nothing new yield no level.
+//
+// Every level carries an error estimate against level 0: the largest
+// difference between the two over level 0's abscissae and the
+// midpoints between them.  Evaluation takes a tolerance and answers
+// from the coarsest level whose estimate meets it.  Outside level 0's
+// abscissae the estimates say nothing; extrapolation diverges fast.
+//
+// Samples are kept, and every level fits them afresh in insertion
+// order, so each level merges exactly as add() would have at its
+// threshold.
+
+#pragma once
+
+#include "polyinterp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+template <typename Scalar>
+struct poly_lod_interpolator // a unary functor
+{
+  typedef poly_interpolator<Scalar> level_type;
+
+  // Each level's threshold is factor times the last, but at least the
+  // smallest gap left, down to levels of min_points points.
+  explicit poly_lod_interpolator(Scalar factor = 2, size_t min_points = 2,
+                                 size_t max_levels = 16)
+      : abscissaDeltaThres(0), factor(factor > 1 ? factor : Scalar(2)),
+        min_points(min_points < 1 ? 1 : min_points),
+        max_levels(max_levels < 1 ? 1 : max_levels) {}
+
+  void set_abscissa_thres(Scalar const &x) {
+    if (0 <= x)
+      abscissaDeltaThres = x;
+  }
+
+  Scalar abscissa_thres() const { return abscissaDeltaThres; }
+
+  void add(Scalar const &x, Scalar const &y) {
+    X.push_back(x);
+    Y.push_back(y);
+  }
+
+  // Builds and fits every level.  Throws as poly_interpolator does;
+  // no levels remain after a throw.
+  void interpolate() {
+    L.clear();
+    E.clear();
+    T.clear();
+    if (X.empty())
+      return;
+    Scalar thres = abscissaDeltaThres;
+    L.push_back(fit(thres));
+    E.push_back(0);
+    T.push_back(thres);
+    try {
+      const std::vector<Scalar> probes = probe_points(L[0].abscissae());
+      while (L.size() < max_levels && L.back().n() > min_points) {
+        // Coarsen until at least one more pair merges.
+        const std::vector<Scalar> &A = L.back().abscissae();
+        Scalar gap = A[1] - A[0];
+        for (size_t i = 2; i < A.size(); i++)
+          gap = std::min(gap, A[i] - A[i - 1]);
+        thres = std::max(thres * factor, gap);
+        level_type next = fit(thres);
+        while (next.n() >= L.back().n()) {
+          thres *= factor;
+          next = fit(thres);
+        }
+        E.push_back(deviation(next, probes));
+        T.push_back(thres);
+        L.push_back(std::move(next));
+      }
+    } catch (...) {
+      L.clear();
+      E.clear();
+      T.clear();
+      throw;
+    }
+  }
+
+  // Level 0.
+  Scalar operator()(const Scalar &x) const {
+    return L.empty() ? x : L[0](x);
+  }
+
+  // The coarsest level whose estimated error is within tolerance.
+  Scalar operator()(const Scalar &x, const Scalar &tolerance) const {
+    return L.empty() ? x : L[select(tolerance)](x);
+  }
+
+  // Evaluates m abscissae x into y at one level for the whole batch.
+  // Answers the level.
+  size_t operator()(const Scalar x[], Scalar y[], size_t m,
+                    const Scalar &tolerance) const {
+    if (L.empty()) {
+      std::copy(x, x + m, y);
+      return 0;
+    }
+    const size_t k = select(tolerance);
+    for (size_t i = 0; i < m; i++)
+      y[i] = L[k](x[i]);
+    return k;
+  }
+
+  // Index of the coarsest level meeting the tolerance; level 0 if none
+  // coarser does.
+  size_t select(const Scalar &tolerance) const {
+    for (size_t k = L.size(); k-- > 1;)
+      if (E[k] <= tolerance)
+        return k;
+    return 0;
+  }
+
+  // Levels fitted by the last interpolate(), finest first, each with
+  // its threshold and estimated error against level 0.
+  size_t levels() const { return L.size(); }
+  const level_type &level(size_t k) const { return L.at(k); }
+  Scalar level_thres(size_t k) const { return T.at(k); }
+  Scalar error(size_t k) const { return E.at(k); }
+
+  // Interpolating points at level 0.
+  size_t n() const { return L.empty() ? 0 : L[0].n(); }
+
+  void clear() {
+    X.clear();
+    Y.clear();
+    L.clear();
+    E.clear();
+    T.clear();
+  }
+
+private:
+  Scalar abscissaDeltaThres;
+  const Scalar factor;
+  const size_t min_points, max_levels;
+  std::vector<Scalar> X, Y; // samples in insertion order
+  std::vector<level_type> L;
+  std::vector<Scalar> E, T;
+
+  level_type fit(Scalar thres) const {
+    level_type p;
+    p.set_abscissa_thres(thres);
+    for (size_t i = 0; i < X.size(); i++)
+      p.add(X[i], Y[i]);
+    p.interpolate();
+    return p;
+  }
+
+  static std::vector<Scalar> probe_points(const std::vector<Scalar> &A) {
+    std::vector<Scalar> probes;
+    for (size_t i = 0; i < A.size(); i++) {
+      if (i != 0)
+        probes.push_back((A[i - 1] + A[i]) / 2);
+      probes.push_back(A[i]);
+    }
+    return probes;
+  }
+
+  // Largest difference from level 0 over the probes.  Not-a-number
+  // counts as infinite.
+  Scalar deviation(const level_type &p,
+                   const std::vector<Scalar> &probes) const {
+    Scalar worst = 0;
+    for (const Scalar &x : probes) {
+      const Scalar d = std::fabs(p(x) - L[0](x));
+      if (!(d <= worst))
+        worst = d == d ? d : std::numeric_limits<Scalar>::infinity();
+    }
+    return worst;
+  }
+};
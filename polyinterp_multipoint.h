@@ -0,0 +1,327 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// Fast multipoint evaluation and interpolation for large n and m.
+//
+// Evaluating a polynomial of n terms at m points costs O(n m) through
+// slatec_polyvl().  The textbook remedy, a subproduct tree of
+// products of linear factors reducing the polynomial by remainders on
+// the way down, fails in floating point.  Its power-basis remainders
+// lose all accuracy by a few dozen points.  So does the Newton form
+// itself, in its sorted-abscissa order, by a hundred or so.
+//
+// This engine keeps the subproduct tree's shape, a balanced binary
+// tree over the sorted abscissae, but works in the well-conditioned
+// barycentric basis,
+//
+//   p(x) = sum w[j] y[j] / (x - x[j]) / sum w[j] / (x - x[j])
+//
+// with weights w[j] = 1 / prod (x[j] - x[k]) over k other than j.
+// Each tree node carries proxy charges at Chebyshev points of its
+// interval.  A target well separated from a node sums the node's few
+// proxies instead of its many points; nearby leaves sum directly.
+// Evaluation costs O(p log n) per point rather than O(n), for p
+// Chebyshev proxies per node.  Interpolation, finding the weights,
+// runs the same tree with the kernel log|x - x[k]|: O(n p log n).
+//
+// All arithmetic runs in double on the variable
+//
+//   t = (x - centre) * 4 / (max - min)
+//
+// that maps the abscissae onto an interval of length four: unit
+// logarithmic capacity, keeping the weights' products in range.
+//
+// Below the crossovers in n or m, points evaluate one by one: by
+// polyvl() for the few abscissae on which the Newton form stays
+// accurate, otherwise by the exact barycentric sum, O(n) per point
+// either way.  Every evaluation by the tree or by polyvl()
+// re-evaluates a spread of probe points by exact sums and reports the
+// worst discrepancy.  Given a tolerance, a breaching evaluation redoes
+// the batch by exact sums.
+
+#pragma once
+
+#include "polyinterp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+struct poly_multipoint_diagnostics {
+  bool fast = false;      // values from the tree?
+  bool exact = false;     // from exact sums?  Else from polyvl().
+  size_t probes = 0;      // points re-evaluated exactly
+  double max_abs_err = 0; // worst probe discrepancy, NaN unprobed
+  double max_rel_err = 0; // ditto relative to the exact value
+};
+
+struct poly_multipoint_options {
+  // Minimum interpolating points and minimum batch size for the fast
+  // path.  Below either, points evaluate one by one.  Measured on
+  // x86-64 at m = 200000: the tree and exact sums break even near
+  // n = 512; at n = 4096 the tree runs five times faster, at n = 16384
+  // fifteen times.
+  size_t crossover_n = 512;
+  size_t crossover_m = 1024;
+  size_t probe_count = 64;
+  // Most interpolating points for which one-by-one evaluation uses
+  // polyvl() rather than exact sums.  The Newton form in sorted order
+  // keeps about 1e-15 on 32 Chebyshev points of exp, 1e-11 on 48 and
+  // nothing on 96; at n = 32 polyvl() runs twice as fast as exact sums.
+  size_t newton_n = 32;
+};
+
+template <typename Scalar>
+class poly_multipoint_evaluator {
+public:
+  explicit poly_multipoint_evaluator(const poly_interpolator<Scalar> &poly,
+                                     const poly_multipoint_options &opts = {})
+      : opts(opts), X(poly.abscissae()), C(poly.coefficients()) {
+    const size_t n = X.size();
+    if (n == 0)
+      return;
+    centre = (double(X.front()) + double(X.back())) / 2;
+    const double width = double(X.back()) - double(X.front());
+    scale = width > 0 ? 4 / width : 1;
+    s.resize(n);
+    for (size_t j = 0; j < n; j++)
+      s[j] = scaled(X[j]);
+    y.assign(poly.ordinates().begin(), poly.ordinates().end());
+    build(0, n);
+    chebyshev();
+    weigh();
+    wy.resize(n);
+    for (size_t j = 0; j < n; j++)
+      wy[j] = w[j] * y[j];
+    proxies(w, qw);
+    proxies(wy, qwy);
+  }
+
+  // Evaluates m abscissae x into y.  Answers diagnostics.  A finite
+  // tolerance on the relative probe error forces exact sums whenever
+  // the tree or polyvl() misses it.
+  poly_multipoint_diagnostics
+  operator()(const Scalar x[], Scalar y[], size_t m,
+             double tolerance = std::numeric_limits<double>::infinity()) const {
+    poly_multipoint_diagnostics d;
+    POLYINTERP_PROBE3(batch_entry, this, X.size(), m);
+    if (X.empty()) {
+      std::copy(x, x + m, y);
+    } else if (X.size() >= opts.crossover_n && m >= opts.crossover_m) {
+      d.fast = true;
+      for (size_t i = 0; i < m; i++)
+        y[i] = Scalar(fast(scaled(x[i])));
+      probe(x, y, m, tolerance, d);
+    } else if (X.size() <= opts.newton_n) {
+      for (size_t i = 0; i < m; i++)
+        polyvl(x[i], &y[i], X.size(), X.data(), C.data());
+      probe(x, y, m, tolerance, d);
+    } else {
+      d.exact = true;
+      for (size_t i = 0; i < m; i++)
+        y[i] = Scalar(exact(scaled(x[i])));
+    }
+    // Nothing probed, nothing known: no error to report, not a zero.
+    if (d.probes == 0)
+      d.max_abs_err = d.max_rel_err = std::nan("");
+    POLYINTERP_PROBE3(batch_exit, this, X.size(), m);
+    return d;
+  }
+
+  // Barycentric weights, normalised to unit maximum magnitude.
+  const std::vector<double> &weights() const { return w; }
+
+private:
+  // Points per leaf, Chebyshev proxies per node, and the separation
+  // ratio: a node of half-width r serves a target at distance d from
+  // its centre by proxies when d >= eta r.  Interpolation error then
+  // falls like (eta + sqrt(eta^2 - 1))^-p, about 1e-15.
+  static constexpr size_t leaf = 32;
+  static constexpr size_t p = 20;
+  static constexpr double eta = 3;
+
+  struct node {
+    size_t lo, hi;       // abscissa index range
+    size_t left, right;  // children, or zero for a leaf
+    double centre, half; // interval
+  };
+
+  const poly_multipoint_options opts;
+  std::vector<Scalar> X, C;
+  double centre = 0, scale = 1;
+  std::vector<double> s, y, w, wy;
+  std::vector<node> tree;      // root first
+  std::vector<double> cheb;    // Chebyshev points, p per node
+  std::vector<double> qw, qwy; // proxy charges, p per node
+
+  double scaled(Scalar x) const { return (double(x) - centre) * scale; }
+
+  // Re-evaluates a spread of probe points by exact sums into d; redoes
+  // the whole batch by exact sums if the worst relative discrepancy
+  // breaches the tolerance.
+  void probe(const Scalar x[], Scalar y[], size_t m, double tolerance,
+             poly_multipoint_diagnostics &d) const {
+    const double huge = std::numeric_limits<double>::infinity();
+    const size_t probes = std::max<size_t>(1, opts.probe_count);
+    const size_t stride = std::max<size_t>(1, m / probes);
+    for (size_t i = 0; i < m; i += stride) {
+      const double r = exact(scaled(x[i]));
+      const double err = std::fabs(double(y[i]) - r);
+      const double rel = r != 0 ? err / std::fabs(r) : err;
+      // Not-a-number counts as the worst error of all.
+      if (!(err <= d.max_abs_err))
+        d.max_abs_err = std::isnan(err) ? huge : err;
+      if (!(rel <= d.max_rel_err))
+        d.max_rel_err = std::isnan(rel) ? huge : rel;
+      ++d.probes;
+    }
+    if (!(d.max_rel_err <= tolerance)) {
+      for (size_t i = 0; i < m; i++)
+        y[i] = Scalar(exact(scaled(x[i])));
+      d.fast = false;
+      d.exact = true;
+    }
+  }
+
+  // Lagrange basis on the node's Chebyshev points at t, by the
+  // barycentric formula for Chebyshev points of the first kind.
+  void lagrange(size_t v, double t, double L[p]) const {
+    static const double pi = std::acos(-1.0);
+    double sum = 0;
+    for (size_t k = 0; k < p; k++) {
+      const double dt = t - cheb[v * p + k];
+      if (dt == 0) {
+        std::fill(L, L + p, 0.0);
+        L[k] = 1;
+        return;
+      }
+      const double sign = k % 2 ? -1 : 1;
+      L[k] = sign * std::sin(pi * double(2 * k + 1) / (2 * p)) / dt;
+      sum += L[k];
+    }
+    for (size_t k = 0; k < p; k++)
+      L[k] /= sum;
+  }
+
+  size_t build(size_t lo, size_t hi) {
+    const size_t at = tree.size();
+    tree.push_back(
+        {lo, hi, 0, 0, (s[lo] + s[hi - 1]) / 2, (s[hi - 1] - s[lo]) / 2});
+    if (hi - lo > leaf) {
+      const size_t mid = lo + (hi - lo) / 2;
+      const size_t left = build(lo, mid);
+      const size_t right = build(mid, hi);
+      tree[at].left = left;
+      tree[at].right = right;
+    }
+    return at;
+  }
+
+  // Chebyshev points of the first kind on every node's interval.
+  void chebyshev() {
+    static const double pi = std::acos(-1.0);
+    cheb.resize(tree.size() * p);
+    for (size_t v = 0; v < tree.size(); v++)
+      for (size_t k = 0; k < p; k++)
+        cheb[v * p + k] =
+            tree[v].centre +
+            tree[v].half * std::cos(pi * double(2 * k + 1) / (2 * p));
+  }
+
+  // Proxy charges for charges a: at every inner node, every point's
+  // charge spread over the node's Chebyshev points.
+  void proxies(const std::vector<double> &a, std::vector<double> &q) const {
+    q.assign(tree.size() * p, 0);
+    double L[p];
+    for (size_t v = 0; v < tree.size(); v++) {
+      if (tree[v].left == 0)
+        continue;
+      for (size_t j = tree[v].lo; j < tree[v].hi; j++) {
+        lagrange(v, s[j], L);
+        for (size_t k = 0; k < p; k++)
+          q[v * p + k] += a[j] * L[k];
+      }
+    }
+  }
+
+  // Sums a[j] kernel(t - s[j]) and b[j] kernel(t - s[j]) over the
+  // tree, excluding index skip, into za and zb; proxies qa and qb
+  // stand in for well-separated nodes.
+  template <typename Kernel>
+  void sum(double t, const Kernel &kernel, const std::vector<double> &a,
+           const std::vector<double> &b, const std::vector<double> &qa,
+           const std::vector<double> &qb, size_t skip, double &za,
+           double &zb) const {
+    size_t stack[64], depth = 0;
+    stack[depth++] = 0;
+    za = zb = 0;
+    while (depth != 0) {
+      const size_t v = stack[--depth];
+      const node &u = tree[v];
+      if (u.left == 0) {
+        for (size_t j = u.lo; j < u.hi; j++)
+          if (j != skip) {
+            const double k = kernel(t - s[j]);
+            za += a[j] * k;
+            zb += b[j] * k;
+          }
+      } else if (std::fabs(t - u.centre) >= eta * u.half) {
+        for (size_t i = v * p; i < v * p + p; i++) {
+          const double k = kernel(t - cheb[i]);
+          za += qa[i] * k;
+          zb += qb[i] * k;
+        }
+      } else {
+        stack[depth++] = u.right;
+        stack[depth++] = u.left;
+      }
+    }
+  }
+
+  // Weights in the log domain, log|w[j]| = -sum log|s[j] - s[k]|,
+  // then normalised; signs alternate from the right.
+  void weigh() {
+    const size_t n = s.size();
+    std::vector<double> ones(n, 1.0), q;
+    proxies(ones, q);
+    auto log_kernel = [](double d) { return std::log(std::fabs(d)); };
+    w.resize(n);
+    double top = -std::numeric_limits<double>::infinity();
+    for (size_t j = 0; j < n; j++) {
+      double z, unused;
+      sum(s[j], log_kernel, ones, ones, q, q, j, z, unused);
+      w[j] = -z;
+      top = std::max(top, w[j]);
+    }
+    for (size_t j = 0; j < n; j++)
+      w[j] = ((n - 1 - j) % 2 ? -1 : 1) * std::exp(w[j] - top);
+  }
+
+  // Ordinate at an abscissa equal to t, if any.
+  const double *hit(double t) const {
+    auto it = std::lower_bound(s.begin(), s.end(), t);
+    return it != s.end() && *it == t ? &y[it - s.begin()] : nullptr;
+  }
+
+  double fast(double t) const {
+    if (const double *yy = hit(t))
+      return *yy;
+    auto cauchy = [](double d) { return 1 / d; };
+    double num, den;
+    sum(t, cauchy, wy, w, qwy, qw, s.size(), num, den);
+    return num / den;
+  }
+
+  double exact(double t) const {
+    if (const double *yy = hit(t))
+      return *yy;
+    double num = 0, den = 0;
+    for (size_t j = 0; j < s.size(); j++) {
+      const double c = w[j] / (t - s[j]);
+      num += c * y[j];
+      den += c;
+    }
+    return num / den;
+  }
+};
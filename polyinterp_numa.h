@@ -0,0 +1,259 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// NUMA-local replicas of fitted interpolators.
+//
+// Threads on one socket that evaluate coefficients resident on
+// another pay for every load across the interconnect.  A catalog
+// keeps one replica of every interpolator per NUMA node and answers
+// each thread's lookup with its own node's replica.
+//
+// Placement relies on the kernel's first-touch policy rather than
+// libnuma: one thread per node, pinned to that node's CPUs, copies
+// every replica for its node, so the replica's pages, its reference
+// count and the node's lookup table fault in locally.  Allocators
+// that recycle memory freed on another node can defeat this; glibc
+// gives each thread its own arena, which mostly keeps them apart.
+//
+// update() refreshes every node's replica of one interpolator,
+// building them in parallel; follow() calls it on every publication
+// of a refit scheduler, so replicas track their calibrations.
+// Topology comes from /sys/devices/system/node: the nodes listed in
+// has_cpu, which may skip numbers, each with its cpulist.  Nodes
+// without CPUs hold no replica, since no thread runs there.
+// Single-node hosts, and hosts that do not say, get one replica
+// built in place.
+
+#pragma once
+
+#include "polyinterp.h"
+#include "polyinterp_scheduler.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class poly_numa_topology {
+public:
+  // The host's nodes, read once.
+  static const poly_numa_topology &system() {
+    static const poly_numa_topology topology("/sys/devices/system/node");
+    return topology;
+  }
+
+  // The nodes described under root, a sysfs node directory or a copy.
+  explicit poly_numa_topology(const std::string &root) {
+    for (int node : read_list(root + "/has_cpu")) {
+      const std::vector<int> list =
+          read_list(root + "/node" + std::to_string(node) + "/cpulist");
+      if (list.empty())
+        continue;
+      for (int cpu : list) {
+        if (size_t(cpu) >= node_of.size())
+          node_of.resize(cpu + 1, 0);
+        node_of[cpu] = cpus.size();
+      }
+      cpus.push_back(list);
+      ids.push_back(node);
+    }
+    if (cpus.empty()) {
+      cpus.emplace_back();
+      ids.push_back(0);
+    }
+  }
+
+  // Nodes with CPUs, numbered densely from zero.
+  size_t nodes() const { return cpus.size(); }
+
+  // The kernel's number for a node.
+  int node_id(size_t node) const { return ids.at(node); }
+
+  // CPUs of a node; empty for the single node of an unknown host.
+  const std::vector<int> &node_cpus(size_t node) const {
+    return cpus.at(node);
+  }
+
+  // Node of the calling thread's current CPU.
+  size_t current_node() const {
+#ifdef __linux__
+    const int cpu = sched_getcpu();
+    if (cpu >= 0 && size_t(cpu) < node_of.size())
+      return node_of[cpu];
+#endif
+    return 0;
+  }
+
+private:
+  std::vector<std::vector<int>> cpus;
+  std::vector<int> ids;
+  std::vector<size_t> node_of; // by CPU
+
+  // A list of ranges like 0-3,8-11; empty if the file will not open.
+  static std::vector<int> read_list(const std::string &path) {
+    std::vector<int> list;
+    std::FILE *f = std::fopen(path.c_str(), "r");
+    if (f == nullptr)
+      return list;
+    int lo, hi;
+    while (std::fscanf(f, "%d", &lo) == 1) {
+      if (std::fscanf(f, "-%d", &hi) != 1)
+        hi = lo;
+      for (int k = lo; k <= hi; k++)
+        list.push_back(k);
+      if (std::fgetc(f) != ',')
+        break;
+    }
+    std::fclose(f);
+    return list;
+  }
+};
+
+template <typename Scalar>
+class poly_numa_catalog {
+public:
+  typedef size_t id_type;
+  typedef poly_interpolator<Scalar> interpolator_type;
+  typedef std::shared_ptr<const interpolator_type> snapshot_type;
+
+  explicit poly_numa_catalog(
+      const poly_numa_topology &topology = poly_numa_topology::system())
+      : topology(topology), tables(topology.nodes()) {
+    if (topology.nodes() > 1)
+      for (size_t node = 0; node < topology.nodes(); node++)
+        builders.emplace_back(new builder(topology.node_cpus(node)));
+    on_every_node([this](size_t node) { tables[node].reset(new table); });
+  }
+
+  poly_numa_catalog(const poly_numa_catalog &) = delete;
+  poly_numa_catalog &operator=(const poly_numa_catalog &) = delete;
+
+  // Replaces every node's replica of id with a copy of poly.
+  void update(id_type id, const interpolator_type &poly) {
+    on_every_node([&](size_t node) {
+      auto replica = std::make_shared<const interpolator_type>(poly);
+      table &t = *tables[node];
+      std::unique_lock<std::shared_mutex> lock(t.mutex);
+      if (id >= t.replicas.size())
+        t.replicas.resize(id + 1);
+      t.replicas[id].swap(replica);
+      // The displaced replica dies here, on its own node.
+    });
+  }
+
+  // The calling thread's node's replica of id; null before the first
+  // update().
+  snapshot_type local(id_type id) const {
+    return on(topology.current_node(), id);
+  }
+
+  snapshot_type on(size_t node, id_type id) const {
+    const table &t = *tables.at(node);
+    std::shared_lock<std::shared_mutex> lock(t.mutex);
+    return id < t.replicas.size() ? t.replicas[id] : nullptr;
+  }
+
+  size_t nodes() const { return tables.size(); }
+
+  // Replicates every snapshot the scheduler publishes from now on.
+  // The catalog must outlive the scheduler, or unhook it first by
+  // on_publish(nullptr).
+  void follow(poly_refit_scheduler<Scalar> &scheduler) {
+    scheduler.on_publish(
+        [this](id_type id, const snapshot_type &s) { update(id, *s); });
+  }
+
+private:
+  struct table {
+    mutable std::shared_mutex mutex;
+    std::vector<snapshot_type> replicas;
+  };
+
+  // A thread pinned to one node's CPUs, running jobs in turn.
+  class builder {
+  public:
+    explicit builder(const std::vector<int> &cpus)
+        : thread([this] { run(); }) {
+#ifdef __linux__
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      for (int cpu : cpus)
+        if (cpu < CPU_SETSIZE)
+          CPU_SET(cpu, &set);
+      pthread_setaffinity_np(thread.native_handle(), sizeof set, &set);
+#else
+      (void)cpus;
+#endif
+    }
+
+    ~builder() {
+      post(nullptr);
+      thread.join();
+    }
+
+    // A null job stops the thread.
+    void post(std::function<void()> job) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+      }
+      ready.notify_one();
+    }
+
+  private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::function<void()>> jobs;
+    std::thread thread;
+
+    void run() {
+      for (;;) {
+        std::function<void()> job;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          ready.wait(lock, [this] { return !jobs.empty(); });
+          job = std::move(jobs.front());
+          jobs.pop_front();
+        }
+        if (!job)
+          return;
+        job();
+      }
+    }
+  };
+
+  const poly_numa_topology &topology;
+  std::vector<std::unique_ptr<table>> tables;
+  std::vector<std::unique_ptr<builder>> builders;
+
+  // Runs fn(node) on a thread of every node, in parallel, and waits.
+  template <typename Fn> void on_every_node(const Fn &fn) {
+    if (builders.empty()) {
+      fn(0);
+      return;
+    }
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t left = builders.size();
+    for (size_t node = 0; node < builders.size(); node++)
+      builders[node]->post([&, node] {
+        fn(node);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--left == 0)
+          done.notify_one();
+      });
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return left == 0; });
+  }
+};
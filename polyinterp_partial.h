@@ -0,0 +1,171 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// Mergeable partial accumulations of points.
+//
+// Points arriving from many partitions fill a poly_interpolator one
+// add() at a time, serially.  A partial holds what add() would have
+// built so far, without the fit: sorted clusters of points, each a
+// sum of abscissae, a sum of ordinates and a count, closer clusters
+// merged under the same threshold.  Workers fill partials of their
+// own partitions independently; merge() then combines two partials in
+// one pass over both, O(n + m), and interpolate() fits the result.
+//
+// Merging folds the other partial's clusters into this one in
+// ascending order, each as add() would take a point standing for
+// all of its points: into its left neighbour when within the
+// threshold of that neighbour's current mean, else into its right
+// neighbour likewise, else on its own, and at the weighted mean.
+// An empty partial changes nothing either way round.  Where clusters
+// fall within the threshold of one another, the result depends on
+// how partials group and in which order, just as add() depends on
+// the order of its calls; elsewhere merging is associative and
+// commutative.
+
+#pragma once
+
+#include "polyinterp.h"
+
+#include <utility>
+#include <vector>
+
+template <typename Scalar>
+class poly_partial {
+public:
+  explicit poly_partial(Scalar thres = 0)
+      : abscissaDeltaThres(0 <= thres ? thres : Scalar(0)) {}
+
+  Scalar abscissa_thres() const { return abscissaDeltaThres; }
+
+  // Accumulates point (x,y) as poly_interpolator::add() would.
+  void add(Scalar const &x, Scalar const &y) {
+    // The first cluster whose mean is not below x.
+    size_t lo = 0, hi = N.size();
+    while (lo < hi) {
+      const size_t mid = lo + (hi - lo) / 2;
+      if (mean(mid) < x)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    size_t i = lo;
+    if (i != 0 && x - mean(i - 1) <= abscissaDeltaThres)
+      --i;
+    else if (i == N.size() || !(mean(i) - x <= abscissaDeltaThres)) {
+      SX.reserve(N.size() + 1);
+      SY.reserve(N.size() + 1);
+      N.reserve(N.size() + 1);
+      SX.insert(SX.begin() + i, x);
+      SY.insert(SY.begin() + i, y);
+      N.insert(N.begin() + i, 1);
+      return;
+    }
+    SX[i] += x;
+    SY[i] += y;
+    ++N[i];
+  }
+
+  // Combines other into this partial at this partial's threshold, as
+  // though each of other's clusters, in ascending order, were one
+  // weighted add().
+  poly_partial &merge(const poly_partial &other) {
+    std::vector<Scalar> ax, ay;
+    std::vector<size_t> an;
+    ax.swap(SX);
+    ay.swap(SY);
+    an.swap(N);
+    const size_t m = an.size() + other.N.size();
+    SX.reserve(m);
+    SY.reserve(m);
+    N.reserve(m);
+    size_t i = 0;
+    for (size_t j = 0; j < other.N.size(); j++) {
+      const Scalar x = other.mean(j);
+      for (; i < an.size() && ax[i] / Scalar(an[i]) < x; i++)
+        push(ax[i], ay[i], an[i]);
+      // The first cluster whose mean is not below x: near the end,
+      // since every cluster so far came before x.
+      size_t p = N.size();
+      while (p != 0 && !(mean(p - 1) < x))
+        --p;
+      if (p == N.size() && i < an.size()) {
+        push(ax[i], ay[i], an[i]);
+        i++;
+      }
+      if (p != 0 && x - mean(p - 1) <= abscissaDeltaThres)
+        --p;
+      else if (p == N.size() || !(mean(p) - x <= abscissaDeltaThres)) {
+        SX.insert(SX.begin() + p, other.SX[j]);
+        SY.insert(SY.begin() + p, other.SY[j]);
+        N.insert(N.begin() + p, other.N[j]);
+        continue;
+      }
+      SX[p] += other.SX[j];
+      SY[p] += other.SY[j];
+      N[p] += other.N[j];
+    }
+    for (; i < an.size(); i++)
+      push(ax[i], ay[i], an[i]);
+    return *this;
+  }
+
+  // An interpolator holding the clusters at their means, with their
+  // counts, fitted.  Throws as poly_interpolator::interpolate() does.
+  poly_interpolator<Scalar> interpolate() const {
+    poly_interpolator<Scalar> poly;
+    poly.set_abscissa_thres(abscissaDeltaThres);
+    poly.X.resize(N.size());
+    poly.Y.resize(N.size());
+    poly.C.resize(N.size());
+    poly.N.resize(N.size());
+    for (size_t i = 0; i < N.size(); i++) {
+      poly.X[i] = mean(i);
+      poly.Y[i] = SY[i] / Scalar(N[i]);
+      poly.N[i] = int(N[i]);
+    }
+    poly.interpolate();
+    return poly;
+  }
+
+  size_t n() const { return N.size(); }
+
+  // Points accumulated, merged or not.
+  size_t count() const {
+    size_t total = 0;
+    for (size_t k : N)
+      total += k;
+    return total;
+  }
+
+  void clear() {
+    SX.clear();
+    SY.clear();
+    N.clear();
+  }
+
+private:
+  Scalar abscissaDeltaThres;
+  std::vector<Scalar> SX, SY; // sums of each cluster's abscissae, ordinates
+  std::vector<size_t> N;      // and its count
+
+  Scalar mean(size_t i) const { return SX[i] / Scalar(N[i]); }
+
+  void push(Scalar sx, Scalar sy, size_t n) {
+    SX.push_back(sx);
+    SY.push_back(sy);
+    N.push_back(n);
+  }
+};
+
+// Merges partials pairwise, first to last, into the first; a balanced
+// tree keeps every point's share of merges logarithmic.
+template <typename Scalar>
+poly_partial<Scalar>
+poly_partial_merge(std::vector<poly_partial<Scalar>> parts) {
+  if (parts.empty())
+    return poly_partial<Scalar>();
+  for (size_t step = 1; step < parts.size(); step *= 2)
+    for (size_t i = 0; i + step < parts.size(); i += 2 * step)
+      parts[i].merge(parts[i + step]);
+  return std::move(parts[0]);
+}
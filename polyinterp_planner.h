@@ -0,0 +1,211 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// Batch query planning.
+//
+// Batches of quantised readings repeat a few abscissae in random
+// order.  A planner evaluates such a batch as a database would:
+// deduplicate the queries through a hash table, sort the distinct
+// abscissae, evaluate them as one ascending, contiguous batch, then
+// scatter the answers back to the original positions.  Every repeat
+// saves an O(n) evaluation for the cost of a hash probe and a
+// scatter; the sort touches only the k distinct abscissae, O(k log
+// k).  Any batch kernel serves for the evaluation: polyvl() by
+// default, or the compiled code of a poly_jit_interpolator, say.
+//
+// Planning does not always pay.  The planner samples a batch first
+// and estimates its distinct abscissae from the repeats within the
+// sample.  Drawing s of m queries over k distinct values shows about
+//
+//   k (1 - exp(-s / k))
+//
+// distinct values; solving for k estimates the whole batch's.  It
+// plans when the evaluations saved outweigh the probing.  Small
+// batches evaluate directly.  So do not-a-number queries, which
+// equal nothing.
+
+#pragma once
+
+#include "polyinterp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <utility>
+#include <vector>
+
+struct poly_plan_diagnostics {
+  bool planned = false;       // was the batch deduplicated?
+  size_t unique = 0;          // distinct abscissae evaluated, if so
+  double unique_fraction = 1; // estimated from the sample
+};
+
+struct poly_plan_options {
+  // Smallest batch to consider planning and most queries sampled to
+  // estimate repeats.  Costs of planning, per query, and of sorting,
+  // per distinct abscissa per comparison, in units of one Newton term
+  // of polyvl().  Measured on x86-64 over 10^5 to 10^6 doubles.
+  size_t min_batch = 256;
+  size_t sample_size = 1024;
+  double plan_cost = 8;
+  double sort_cost = 4;
+};
+
+template <typename Scalar>
+class poly_query_planner {
+public:
+  typedef std::function<void(const Scalar x[], Scalar y[], size_t m)>
+      kernel_type;
+
+  // Plans over polyvl() on the interpolator's current fit.  Refits
+  // need a new planner.
+  explicit poly_query_planner(const poly_interpolator<Scalar> &poly,
+                              const poly_plan_options &opts = {})
+      : opts(opts), kernel([X = poly.abscissae(), C = poly.coefficients()](
+                   const Scalar x[], Scalar y[], size_t m) {
+          if (X.empty())
+            std::copy(x, x + m, y);
+          else
+            for (size_t i = 0; i < m; i++)
+              polyvl(x[i], &y[i], X.size(), X.data(), C.data());
+        }),
+        terms(poly.n()) {}
+
+  // Plans over any batch kernel costing about the given number of
+  // Newton terms per query.
+  poly_query_planner(kernel_type kernel, size_t terms,
+                     const poly_plan_options &opts = {})
+      : opts(opts), kernel(std::move(kernel)), terms(terms) {}
+
+  // Evaluates m abscissae x into y.  Reuses scratch space, so keep
+  // one planner per thread.
+  poly_plan_diagnostics operator()(const Scalar x[], Scalar y[], size_t m) {
+    poly_plan_diagnostics d;
+    if (m < opts.min_batch) {
+      kernel(x, y, m);
+      return d;
+    }
+    // Per query: the evaluations saved against probing, scattering
+    // and sorting the distinct abscissae.
+    const double u = d.unique_fraction = estimate(x, m);
+    const double saved = (1 - u) * double(terms);
+    const double distinct = std::max(2.0, u * double(m));
+    const double cost =
+        opts.plan_cost + u * opts.sort_cost * std::log2(distinct);
+    if (!(saved > cost)) {
+      kernel(x, y, m);
+      return d;
+    }
+    d.planned = true;
+
+    // Number the distinct abscissae in order of appearance.
+    const uint32_t none = UINT32_MAX;
+    size_t size = 64;
+    while (size < 2 * d.unique_fraction * double(m))
+      size *= 2;
+    table.assign(size, none);
+    ux.clear();
+    slot.resize(m);
+    for (size_t i = 0; i < m; i++) {
+      if (!(x[i] == x[i])) {
+        kernel(&x[i], &y[i], 1);
+        slot[i] = none;
+        continue;
+      }
+      size_t h = hash(x[i]) & (table.size() - 1);
+      while (table[h] != none && !(ux[table[h]] == x[i]))
+        h = (h + 1) & (table.size() - 1);
+      if (table[h] != none)
+        slot[i] = table[h];
+      else {
+        slot[i] = table[h] = uint32_t(ux.size());
+        ux.push_back(x[i]);
+        if (2 * ux.size() > table.size())
+          grow();
+      }
+    }
+
+    // Evaluate them in ascending order; answer in order of appearance.
+    const size_t k = ux.size();
+    rank.resize(k);
+    for (uint32_t j = 0; j < k; j++)
+      rank[j] = j;
+    std::sort(rank.begin(), rank.end(),
+              [this](uint32_t a, uint32_t b) { return ux[a] < ux[b]; });
+    sx.resize(k);
+    sy.resize(k);
+    for (size_t r = 0; r < k; r++)
+      sx[r] = ux[rank[r]];
+    kernel(sx.data(), sy.data(), k);
+    uy.resize(k);
+    for (size_t r = 0; r < k; r++)
+      uy[rank[r]] = sy[r];
+    for (size_t i = 0; i < m; i++)
+      if (slot[i] != none)
+        y[i] = uy[slot[i]];
+    d.unique = k;
+    return d;
+  }
+
+private:
+  const poly_plan_options opts;
+  const kernel_type kernel;
+  const size_t terms;
+  std::vector<uint32_t> table, slot, rank;
+  std::vector<Scalar> ux, uy, sx, sy, sample;
+
+  // Mixes the bit pattern by the SplitMix64 finaliser: quantised
+  // abscissae differ only in their high bits.  Negative and positive
+  // zero hash apart; both evaluate alike.
+  static size_t hash(const Scalar &x) {
+    uint64_t z = 0;
+    std::memcpy(&z, &x, sizeof x < sizeof z ? sizeof x : sizeof z);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+    return size_t(z ^ (z >> 31));
+  }
+
+  // Doubles the table, keeping every abscissa's number.
+  void grow() {
+    table.assign(2 * table.size(), UINT32_MAX);
+    for (uint32_t u = 0; u < ux.size(); u++) {
+      size_t h = hash(ux[u]) & (table.size() - 1);
+      while (table[h] != UINT32_MAX)
+        h = (h + 1) & (table.size() - 1);
+      table[h] = u;
+    }
+  }
+
+  // Estimated fraction of distinct abscissae among the batch's m,
+  // from a strided sample.  Counts two standard deviations fewer
+  // repeats than the sample shows, erring towards no planning.
+  double estimate(const Scalar x[], size_t m) {
+    sample.clear();
+    const size_t s = std::min(opts.sample_size, m / 4);
+    for (size_t i = 0; i < s; i++)
+      if (x[i * m / s] == x[i * m / s])
+        sample.push_back(x[i * m / s]);
+    std::sort(sample.begin(), sample.end());
+    const double seen = double(sample.size());
+    const double repeats =
+        seen - double(std::unique(sample.begin(), sample.end()) -
+                      sample.begin());
+    const double distinct = seen - (repeats - 2 * std::sqrt(repeats));
+    if (!(distinct < seen))
+      return 1;
+    // k (1 - exp(-seen / k)) rises with k, from below distinct at k
+    // equal to distinct towards seen; bisect for where it meets
+    // distinct.
+    double lo = distinct, hi = distinct;
+    auto shown = [seen](double k) { return k * -std::expm1(-seen / k); };
+    while (shown(hi) < distinct && hi < double(m))
+      hi *= 2;
+    for (int i = 0; i < 40; i++) {
+      const double mid = (lo + hi) / 2;
+      (shown(mid) < distinct ? lo : hi) = mid;
+    }
+    return std::min(1.0, hi / double(m));
+  }
+};
@@ -0,0 +1,360 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// Workload capture.
+//
+// A poly_trace_recorder logs interpolator calls to a binary trace:
+// threshold changes, add(x,y), interpolate(), evaluations and
+// clear(), each stamped with nanoseconds since the recorder started
+// and with the small integer identifying its instance.  Every record
+// takes 32 bytes, little-endian as the host writes it.  The file
+// opens with an eight-byte magic number.
+//
+// Recording must cost little beside an evaluation of a few
+// nanoseconds.  Each thread appends its records to a buffer of its
+// own, taking no lock, and writes a full buffer to the file under the
+// recorder's lock; flush() writes what every buffer holds.  Stamps come
+// from the time-stamp counter on x86-64, scaled to nanoseconds as
+// records reach the file, and from the steady clock elsewhere.
+// Threads' records therefore reach the file out of order; load()
+// sorts them by time.  A thread's buffers last until their recorder
+// is destroyed or the thread exits and flush() has written them,
+// whichever comes first.
+//
+// A poly_recorded_interpolator behaves as a poly_interpolator and
+// reports each of its calls to a recorder.  Evaluations log the
+// answer as well as the abscissa, so a replay can check its own.
+// polyinterp_replay re-executes a trace against other engines.
+
+#pragma once
+
+#include "polyinterp.h"
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+enum poly_trace_status {
+  poly_trace_success,
+  poly_trace_io_error = -1,
+  poly_trace_bad_format = -2
+};
+
+enum poly_trace_op : uint8_t {
+  poly_trace_create,      // x: 1 for float, 2 for double
+  poly_trace_thres,       // x: threshold
+  poly_trace_add,         // x, y: point
+  poly_trace_interpolate, // y: slatec_polint_status
+  poly_trace_evaluate,    // x: abscissa; y: answer
+  poly_trace_clear
+};
+
+struct poly_trace_record {
+  uint64_t time; // nanoseconds since the recorder started
+  uint32_t id;   // instance
+  uint8_t op;    // poly_trace_op
+  uint8_t pad[3];
+  double x, y;
+};
+
+static_assert(sizeof(poly_trace_record) == 32, "trace records pack");
+
+static const char poly_trace_magic[8] = {'p', 'o', 'l', 'y', 't', 'r', 'c', 1};
+
+class poly_trace_recorder {
+public:
+  typedef uint32_t id_type;
+
+  // Creates or truncates the trace at path.  Throws
+  // poly_trace_io_error if it cannot.
+  explicit poly_trace_recorder(const char *path, size_t buffer = 4096)
+      : file(std::fopen(path, "wb")), capacity(buffer ? buffer : 1),
+        serial(++serials), start(std::chrono::steady_clock::now()),
+        start_ticks(ticks()) {
+    if (file == nullptr)
+      throw poly_trace_io_error;
+    if (std::fwrite(poly_trace_magic, sizeof poly_trace_magic, 1, file) != 1) {
+      std::fclose(file);
+      throw poly_trace_io_error;
+    }
+  }
+
+  poly_trace_recorder(const poly_trace_recorder &) = delete;
+  poly_trace_recorder &operator=(const poly_trace_recorder &) = delete;
+
+  ~poly_trace_recorder() {
+    flush();
+    std::fclose(file);
+    // Drop this recorder's buffers from every thread's list.
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (thread_buffers *t : registry) {
+      std::lock_guard<std::mutex> held(t->mutex);
+      t->list.erase(std::remove_if(t->list.begin(), t->list.end(),
+                                   [this](const auto &m) {
+                                     return m.first == serial;
+                                   }),
+                    t->list.end());
+    }
+  }
+
+  // A new instance identifier, logged with its Scalar's size.
+  template <typename Scalar> id_type attach() {
+    const id_type id = instances++;
+    log(id, poly_trace_create, double(sizeof(Scalar) / 4));
+    return id;
+  }
+
+  void log(id_type id, poly_trace_op op, double x = 0, double y = 0) {
+    buffer &b = local();
+    const size_t k = b.count.load(std::memory_order_relaxed);
+    b.records[k] = {ticks(), id, op, {}, x, y};
+    b.count.store(k + 1, std::memory_order_release);
+    if (k + 1 == capacity) {
+      std::lock_guard<std::mutex> lock(mutex);
+      write(b, capacity);
+      b.flushed = 0;
+      b.count.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // Writes every thread's buffered records out.  Answers false once
+  // any write fails; records after a failure are lost.
+  bool flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const std::shared_ptr<buffer> &b : buffers)
+      write(*b, b->count.load(std::memory_order_acquire));
+    // Drop the buffers of threads since finished.
+    buffers.erase(std::remove_if(buffers.begin(), buffers.end(),
+                                 [](const std::shared_ptr<buffer> &b) {
+                                   return b.use_count() == 1;
+                                 }),
+                  buffers.end());
+    return good && std::fflush(file) == 0;
+  }
+
+  // Thread buffers allocated by every recorder and not yet freed.
+  static size_t live_buffers() { return live; }
+
+  // Reads a whole trace.  Throws poly_trace_io_error or
+  // poly_trace_bad_format, the latter for a torn final record and for
+  // a record naming an instance no create record introduced.
+  static std::vector<poly_trace_record> load(const char *path) {
+    std::FILE *in = std::fopen(path, "rb");
+    if (in == nullptr)
+      throw poly_trace_io_error;
+    char magic[sizeof poly_trace_magic];
+    std::vector<poly_trace_record> trace;
+    enum poly_trace_status status = poly_trace_success;
+    if (std::fread(magic, sizeof magic, 1, in) != 1 ||
+        std::memcmp(magic, poly_trace_magic, sizeof magic) != 0)
+      status = poly_trace_bad_format;
+    else {
+      poly_trace_record r;
+      while (std::fread(&r, sizeof r, 1, in) == 1)
+        trace.push_back(r);
+      if (std::ferror(in))
+        status = poly_trace_io_error;
+      else if (std::ftell(in) !=
+               long(sizeof magic + trace.size() * sizeof(poly_trace_record)))
+        status = poly_trace_bad_format; // a torn final record
+    }
+    std::stable_sort(
+        trace.begin(), trace.end(),
+        [](const poly_trace_record &a, const poly_trace_record &b) {
+          return a.time < b.time;
+        });
+    std::fclose(in);
+    if (status == poly_trace_success && !named(trace))
+      status = poly_trace_bad_format;
+    if (status != poly_trace_success)
+      throw status;
+    return trace;
+  }
+
+private:
+  // One thread appends to records and publishes count; the recorder,
+  // under its lock, writes out records from flushed up to count.  Only
+  // the appending thread, under the lock too, starts a full buffer
+  // over.
+  struct buffer {
+    explicit buffer(size_t capacity)
+        : records(new poly_trace_record[capacity]) {
+      ++live;
+    }
+    ~buffer() { --live; }
+    std::unique_ptr<poly_trace_record[]> records;
+    std::atomic<size_t> count{0};
+    size_t flushed = 0;
+  };
+
+  // A thread's buffers, one per recorder it logs to, registered while
+  // the thread lives.  A recorder dropping its buffers locks the
+  // registry, then each list.
+  struct thread_buffers {
+    std::mutex mutex;
+    std::vector<std::pair<uint64_t, std::shared_ptr<buffer>>> list;
+    thread_buffers() {
+      std::lock_guard<std::mutex> lock(registry_mutex);
+      registry.push_back(this);
+    }
+    ~thread_buffers() {
+      std::lock_guard<std::mutex> lock(registry_mutex);
+      registry.erase(std::find(registry.begin(), registry.end(), this));
+    }
+  };
+
+  std::FILE *const file;
+  const size_t capacity;
+  const uint64_t serial; // tells recorders apart, addresses reused
+  const std::chrono::steady_clock::time_point start;
+  const uint64_t start_ticks;
+  std::mutex mutex; // of the file and the buffer list
+  std::vector<std::shared_ptr<buffer>> buffers;
+  std::atomic<id_type> instances{0};
+  bool good = true;
+
+  static inline std::atomic<uint64_t> serials{0};
+  static inline std::atomic<size_t> live{0};
+  static inline std::mutex registry_mutex;
+  static inline std::vector<thread_buffers *> registry;
+
+  // The calling thread's buffer, registered on first use.
+  buffer &local() {
+    thread_local uint64_t last_serial = 0;
+    thread_local buffer *last = nullptr;
+    if (last_serial == serial)
+      return *last;
+    thread_local thread_buffers mine;
+    std::lock_guard<std::mutex> held(mine.mutex);
+    for (const auto &m : mine.list)
+      if (m.first == serial) {
+        last_serial = serial;
+        return *(last = m.second.get());
+      }
+    auto b = std::make_shared<buffer>(capacity);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      buffers.push_back(b);
+    }
+    mine.list.emplace_back(serial, b);
+    last_serial = serial;
+    return *(last = b.get());
+  }
+
+  // Does every record name an instance some create record introduced?
+  // Instances number from zero in order of creation, though threads'
+  // create records may interleave out of that order.
+  static bool named(const std::vector<poly_trace_record> &trace) {
+    size_t created = 0;
+    for (const poly_trace_record &r : trace)
+      created += r.op == poly_trace_create;
+    std::vector<bool> seen(created);
+    for (const poly_trace_record &r : trace) {
+      if (r.id >= created)
+        return false;
+      if (r.op == poly_trace_create) {
+        if (seen[r.id])
+          return false;
+        seen[r.id] = true;
+      } else if (!seen[r.id])
+        return false;
+    }
+    return true;
+  }
+
+  static uint64_t ticks() {
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+  // Writes b's records up to end, converting ticks to nanoseconds
+  // since the start.
+  void write(buffer &b, size_t end) {
+    if (end <= b.flushed)
+      return;
+    double ns_per_tick = 1;
+#if defined(__x86_64__)
+    const uint64_t now = ticks();
+    const double ns = std::chrono::duration<double, std::nano>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    if (now > start_ticks)
+      ns_per_tick = ns / double(now - start_ticks);
+#endif
+    poly_trace_record *first = &b.records[b.flushed];
+    const size_t count = end - b.flushed;
+    for (size_t i = 0; i < count; i++) {
+      const uint64_t t = first[i].time;
+      first[i].time =
+          t > start_ticks ? uint64_t(double(t - start_ticks) * ns_per_tick) : 0;
+    }
+    if (std::fwrite(first, sizeof(poly_trace_record), count, file) != count)
+      good = false;
+    b.flushed = end;
+  }
+};
+
+template <typename Scalar>
+struct poly_recorded_interpolator : poly_interpolator<Scalar> {
+  typedef poly_interpolator<Scalar> base;
+
+  // The recorder must outlive the interpolator.
+  explicit poly_recorded_interpolator(poly_trace_recorder &recorder)
+      : recorder(recorder), id(recorder.template attach<Scalar>()) {}
+
+  void set_abscissa_thres(Scalar const &x) {
+    recorder.log(id, poly_trace_thres, double(x));
+    base::set_abscissa_thres(x);
+  }
+
+  void add(Scalar const &x, Scalar const &y) {
+    recorder.log(id, poly_trace_add, double(x), double(y));
+    base::add(x, y);
+  }
+
+  // Logs the fit's status, failures included, before any throw.
+  void interpolate() {
+    enum slatec_polint_status status = slatec_polint_success;
+    try {
+      base::interpolate();
+    } catch (enum slatec_polint_status thrown) {
+      status = thrown;
+    }
+    recorder.log(id, poly_trace_interpolate, 0, double(status));
+    if (status != slatec_polint_success)
+      throw status;
+  }
+
+  Scalar operator()(const Scalar &x) const {
+    const Scalar y = base::operator()(x);
+    recorder.log(id, poly_trace_evaluate, double(x), double(y));
+    return y;
+  }
+
+  void clear() {
+    recorder.log(id, poly_trace_clear);
+    base::clear();
+  }
+
+  poly_trace_recorder::id_type trace_id() const { return id; }
+
+private:
+  poly_trace_recorder &recorder;
+  const poly_trace_recorder::id_type id;
+};
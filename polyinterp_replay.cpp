@@ -0,0 +1,255 @@
+// SPDX-License-Identifier: MIT
+//
+// Workload replay.
+//
+// Re-executes a trace written by poly_trace_recorder against one or
+// more engine configurations.  Every recorded instance becomes an
+// instance of the configuration's engine, whatever its recorded
+// precision; every recorded call repeats in order.  Per
+// configuration, one table row results: operations per second over
+// the whole replay, median, 99th-percentile and worst latency per
+// kind of call, failed fits, and the worst absolute difference
+// between replayed and recorded answers.
+//
+// Replays run flat out by default.  A first pass times the whole
+// trace for throughput; a second times each call for latency, since
+// clock reads would otherwise dominate cheap evaluations.  Given -p,
+// one pass keeps the original pacing, sleeping until each call's
+// recorded time divided by the speed-up given by -x.
+//
+// Usage: polyinterp_replay [-e engine]... [-p] [-x speed] trace
+
+#include "polyinterp.h"
+#include "polyinterp_jit.h"
+#include "polyinterp_record.h"
+#include "polyinterp_taylor.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////
+// Engines
+
+// One recorded instance replayed through some engine.
+struct replica {
+  virtual ~replica() {}
+  virtual void set_abscissa_thres(double x) = 0;
+  virtual void add(double x, double y) = 0;
+  virtual void interpolate() = 0; // throws as poly_interpolator does
+  virtual double operator()(double x) = 0;
+  virtual void clear() = 0;
+};
+
+template <typename Scalar, typename Interpolator>
+struct plain_replica : replica {
+  Interpolator p;
+  void set_abscissa_thres(double x) override { p.set_abscissa_thres(x); }
+  void add(double x, double y) override { p.add(Scalar(x), Scalar(y)); }
+  void interpolate() override { p.interpolate(); }
+  double operator()(double x) override { return p(Scalar(x)); }
+  void clear() override { p.clear(); }
+};
+
+template <typename Scalar> struct taylor_replica : replica {
+  poly_interpolator<Scalar> p;
+  poly_taylor_cache<Scalar> t{p, Scalar(1e-10)};
+  void set_abscissa_thres(double x) override { p.set_abscissa_thres(x); }
+  void add(double x, double y) override { p.add(Scalar(x), Scalar(y)); }
+  void interpolate() override {
+    p.interpolate();
+    t.reset(p);
+  }
+  double operator()(double x) override { return t(Scalar(x)); }
+  void clear() override {
+    p.clear();
+    t.reset(p);
+  }
+};
+
+struct engine {
+  std::string name;
+  std::function<std::unique_ptr<replica>()> make;
+};
+
+template <typename Replica> static engine engine_of(const char *name) {
+  return {name, [] { return std::unique_ptr<replica>(new Replica); }};
+}
+
+////////////////////////////////////////////////////////////////////////
+// Replay
+
+struct latencies {
+  std::vector<double> ns;
+
+  double quantile(double q) {
+    if (ns.empty())
+      return 0;
+    const size_t k = std::min(ns.size() - 1, size_t(q * double(ns.size())));
+    std::nth_element(ns.begin(), ns.begin() + k, ns.end());
+    return ns[k];
+  }
+};
+
+struct result {
+  double seconds = 0;
+  size_t failures = 0;
+  double max_dev = 0; // worst |replayed - recorded| answer
+  latencies op[poly_trace_clear + 1];
+};
+
+// Replays the trace once.  Times every call if timed, otherwise only
+// the whole.  Sleeps to the recorded pacing if speed is positive.
+static result replay(const std::vector<poly_trace_record> &trace,
+                     const engine &e, bool timed, double speed) {
+  typedef std::chrono::steady_clock clock;
+  result out;
+  std::vector<std::unique_ptr<replica>> instances;
+  auto instance = [&](uint32_t id) -> replica & {
+    if (id >= instances.size())
+      instances.resize(id + 1);
+    if (!instances[id])
+      instances[id] = e.make();
+    return *instances[id];
+  };
+  const auto t0 = clock::now();
+  for (const poly_trace_record &r : trace) {
+    if (speed > 0)
+      std::this_thread::sleep_until(
+          t0 + std::chrono::nanoseconds(uint64_t(double(r.time) / speed)));
+    replica &p = instance(r.id);
+    const auto t = timed ? clock::now() : t0;
+    switch (r.op) {
+    case poly_trace_create:
+      break;
+    case poly_trace_thres:
+      p.set_abscissa_thres(r.x);
+      break;
+    case poly_trace_add:
+      p.add(r.x, r.y);
+      break;
+    case poly_trace_interpolate:
+      try {
+        p.interpolate();
+      } catch (enum slatec_polint_status) {
+        ++out.failures;
+      }
+      break;
+    case poly_trace_evaluate: {
+      const double dev = std::fabs(p(r.x) - r.y);
+      if (!(dev <= out.max_dev))
+        out.max_dev = std::isnan(dev) ? HUGE_VAL : dev;
+      break;
+    }
+    case poly_trace_clear:
+      p.clear();
+      break;
+    default:
+      continue;
+    }
+    if (timed)
+      out.op[r.op].ns.push_back(
+          std::chrono::duration<double, std::nano>(clock::now() - t).count());
+  }
+  out.seconds = std::chrono::duration<double>(clock::now() - t0).count();
+  return out;
+}
+
+int main(int argc, char *argv[]) {
+  const std::vector<engine> es{
+      engine_of<plain_replica<double, poly_interpolator<double>>>(
+          "polyvl<double>"),
+      engine_of<plain_replica<float, poly_interpolator<float>>>(
+          "polyvl<float>"),
+      engine_of<plain_replica<double, poly_jit_interpolator<double>>>(
+          "jit<double>"),
+      engine_of<plain_replica<float, poly_jit_interpolator<float>>>(
+          "jit<float>"),
+      engine_of<taylor_replica<double>>("taylor<double>"),
+  };
+  std::vector<engine> chosen;
+  bool paced = false;
+  double speed = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "e:px:")) != -1)
+    switch (opt) {
+    case 'e': {
+      auto it = std::find_if(es.begin(), es.end(), [](const engine &e) {
+        return e.name == optarg;
+      });
+      if (it == es.end()) {
+        fprintf(stderr, "%s: unknown engine %s; choose from", argv[0], optarg);
+        for (const engine &e : es)
+          fprintf(stderr, " %s", e.name.c_str());
+        fprintf(stderr, "\n");
+        return EXIT_FAILURE;
+      }
+      chosen.push_back(*it);
+      break;
+    }
+    case 'p':
+      paced = true;
+      break;
+    case 'x':
+      speed = atof(optarg);
+      break;
+    default:
+      return EXIT_FAILURE;
+    }
+  if (optind + 1 != argc || !(speed > 0)) {
+    fprintf(stderr, "usage: %s [-e engine]... [-p] [-x speed] trace\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (chosen.empty())
+    chosen = es;
+
+  std::vector<poly_trace_record> trace;
+  try {
+    trace = poly_trace_recorder::load(argv[optind]);
+  } catch (enum poly_trace_status status) {
+    fprintf(stderr, "%s: %s: %s\n", argv[0], argv[optind],
+            status == poly_trace_bad_format ? "not a trace" : strerror(errno));
+    return EXIT_FAILURE;
+  }
+  const double recorded = trace.empty() ? 0 : trace.back().time / 1e9;
+  printf("%zu records over %.3f s\n", trace.size(), recorded);
+
+  static const char *ops[] = {"create", "thres", "add",
+                              "interpolate", "evaluate", "clear"};
+  printf("%-16s %12s %-12s %8s %10s %10s %10s %6s %10s\n", "engine", "ops/s",
+         "call", "count", "p50 ns", "p99 ns", "max ns", "fails", "max dev");
+  for (const engine &e : chosen) {
+    result timing = replay(trace, e, paced, paced ? speed : 0);
+    result lat = paced ? timing : replay(trace, e, true, 0);
+    bool first = true;
+    for (int op = poly_trace_thres; op <= poly_trace_clear; op++) {
+      latencies &l = lat.op[op];
+      if (l.ns.empty())
+        continue;
+      const size_t count = l.ns.size();
+      const double p50 = l.quantile(0.5), p99 = l.quantile(0.99),
+                   max = l.quantile(1);
+      if (first)
+        printf("%-16s %12.4g %-12s %8zu %10.0f %10.0f %10.0f %6zu %10.3g\n",
+               e.name.c_str(), double(trace.size()) / timing.seconds, ops[op],
+               count, p50, p99, max, timing.failures, timing.max_dev);
+      else
+        printf("%-16s %12s %-12s %8zu %10.0f %10.0f %10.0f\n", "", "",
+               ops[op], count, p50, p99, max);
+      first = false;
+    }
+  }
+  return EXIT_SUCCESS;
+}
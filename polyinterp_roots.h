@@ -0,0 +1,204 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// Real roots and level crossings on an interval.
+//
+// Sampling p(x) densely for sign changes costs thousands of
+// evaluations and still misses two crossings closer than the step.
+// Instead, poly_roots() finds every real root of p(x) - level on
+// [a, b] by Bernstein subdivision.  Over the interval's Bernstein
+// basis, the number of sign changes among the coefficients bounds
+// the number of roots, and equals it when it is zero or one.
+// Intervals showing none are discarded; intervals showing one
+// isolate a root; the rest split in half by de Casteljau's
+// algorithm.  Each isolated root then refines by Newton's method on
+// the Newton form, p and p' together in O(n), falling back to
+// bisection whenever a step leaves the bracket.
+//
+// The Bernstein coefficients come straight from the Newton form,
+//
+//   p(x) = c[0] + (x - x[0]) (c[1] + (x - x[1]) (c[2] + ...)),
+//
+// by nested multiplication in the Bernstein basis: multiplying by a
+// linear factor and adding a constant both stay within it, never
+// touching the ill-conditioned power basis.  O(n^2) once; every
+// level subtracts from every coefficient, the basis summing to one.
+// Each split costs O(n^2) too.
+//
+// Intervals that narrow to rounding level still showing changes,
+// clusters closer than rounding can separate, report their midpoint
+// once.  Rounding decides whether a tangency crosses twice, about
+// sqrt(epsilon) apart, or not at all.  A p identically equal to
+// level reports no roots.  Roots return in ascending order.
+
+#pragma once
+
+#include "polyinterp.h"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// p and dp/dx at xx from n Newton coefficients c on abscissae x.
+template <typename Scalar>
+void polyvl_derivative(Scalar xx, Scalar *yy, Scalar *dy, size_t n,
+                       const Scalar x[], const Scalar c[]) {
+  Scalar p = c[n - 1], dp = 0;
+  for (size_t k = n - 1; k-- > 0;) {
+    dp = dp * (xx - x[k]) + p;
+    p = p * (xx - x[k]) + c[k];
+  }
+  *yy = p;
+  *dy = dp;
+}
+
+template <typename Scalar>
+class poly_root_finder {
+public:
+  // Bernstein coefficients of poly over [a, b], computed once for any
+  // number of levels.
+  poly_root_finder(const poly_interpolator<Scalar> &poly, Scalar a, Scalar b)
+      : X(poly.abscissae()), C(poly.coefficients()), a(a), b(b) {
+    const size_t n = X.size();
+    if (n == 0)
+      return;
+    // Nested multiplication: B = c[n-1]; then B = B (x - x[k]) + c[k].
+    B.assign(1, C[n - 1]);
+    for (size_t k = n - 1; k-- > 0;) {
+      const Scalar alpha = a - X[k], beta = b - X[k];
+      const size_t d = B.size(); // degree plus one
+      std::vector<Scalar> R(d + 1);
+      for (size_t i = 0; i <= d; i++) {
+        Scalar r = 0;
+        if (i < d)
+          r = r + Scalar(d - i) * alpha * B[i];
+        if (i > 0)
+          r = r + Scalar(i) * beta * B[i - 1];
+        R[i] = r / Scalar(d) + C[k];
+      }
+      B.swap(R);
+    }
+  }
+
+  // Every root of p(x) - level in [a, b], ascending.
+  std::vector<Scalar> operator()(Scalar level = 0) const {
+    std::vector<Scalar> roots;
+    if (!(a <= b))
+      return roots;
+    if (X.empty()) {
+      // An empty interpolator answers its abscissa.
+      if (a <= level && level <= b)
+        roots.push_back(level);
+      return roots;
+    }
+    std::vector<Scalar> q(B);
+    bool zero = true;
+    for (Scalar &v : q) {
+      v = v - level;
+      zero = zero && v == 0;
+    }
+    if (zero)
+      return roots;
+    if (q.front() == 0)
+      roots.push_back(a);
+    isolate(q, a, b, level, roots);
+    if (a != b && q.back() == 0)
+      roots.push_back(b);
+    return roots;
+  }
+
+private:
+  std::vector<Scalar> X, C, B;
+  const Scalar a, b;
+
+  static size_t changes(const std::vector<Scalar> &q) {
+    size_t count = 0;
+    int last = 0;
+    for (const Scalar &v : q) {
+      const int sign = v > 0 ? 1 : v < 0 ? -1 : 0;
+      if (sign != 0) {
+        if (last != 0 && sign != last)
+          ++count;
+        last = sign;
+      }
+    }
+    return count;
+  }
+
+  // Roots strictly inside (lo, hi) of the polynomial with Bernstein
+  // coefficients q there, appended in order.
+  void isolate(const std::vector<Scalar> &q, Scalar lo, Scalar hi,
+               Scalar level, std::vector<Scalar> &roots) const {
+    const size_t v = changes(q);
+    if (v == 0)
+      return;
+    const Scalar mid = lo + (hi - lo) / 2;
+    const bool narrow = !(lo < mid && mid < hi) ||
+                        hi - lo <= 4 * std::numeric_limits<Scalar>::epsilon() *
+                                       (std::fabs(lo) + std::fabs(hi));
+    if (narrow) {
+      if (roots.empty() || roots.back() < lo)
+        roots.push_back(mid);
+      return;
+    }
+    if (v == 1 && q.front() != 0 && q.back() != 0) {
+      roots.push_back(refine(lo, hi, q.front() < 0, level));
+      return;
+    }
+    // de Casteljau at one half.
+    const size_t n = q.size();
+    std::vector<Scalar> left(n), right(n), w(q);
+    for (size_t r = 0; r < n; r++) {
+      left[r] = w[0];
+      right[n - 1 - r] = w[n - 1 - r];
+      for (size_t i = 0; i + 1 < n - r; i++)
+        w[i] = (w[i] + w[i + 1]) / 2;
+    }
+    isolate(left, lo, mid, level, roots);
+    if (left.back() == 0 && (roots.empty() || roots.back() < mid))
+      roots.push_back(mid);
+    isolate(right, mid, hi, level, roots);
+  }
+
+  // The root bracketed by (lo, hi), where p - level rises if rising.
+  Scalar refine(Scalar lo, Scalar hi, bool rising, Scalar level) const {
+    Scalar x = lo + (hi - lo) / 2;
+    for (int i = 0; i < 100; i++) {
+      Scalar p, dp;
+      polyvl_derivative(x, &p, &dp, X.size(), X.data(), C.data());
+      p = p - level;
+      if (p == 0)
+        return x;
+      if ((p < 0) == rising)
+        lo = x;
+      else
+        hi = x;
+      Scalar next = x - p / dp;
+      if (!(lo < next && next < hi))
+        next = lo + (hi - lo) / 2;
+      if (next == x || !(lo < next && next < hi))
+        return x;
+      x = next;
+    }
+    return x;
+  }
+};
+
+// Every root of p(x) - level in [a, b], ascending.
+template <typename Scalar>
+std::vector<Scalar> poly_roots(const poly_interpolator<Scalar> &poly, Scalar a,
+                               Scalar b, Scalar level = 0) {
+  return poly_root_finder<Scalar>(poly, a, b)(level);
+}
+
+// The crossings of each of count levels, sharing one conversion.
+template <typename Scalar>
+std::vector<std::vector<Scalar>>
+poly_roots(const poly_interpolator<Scalar> &poly, Scalar a, Scalar b,
+           const Scalar levels[], size_t count) {
+  poly_root_finder<Scalar> finder(poly, a, b);
+  std::vector<std::vector<Scalar>> roots;
+  for (size_t i = 0; i < count; i++)
+    roots.push_back(finder(levels[i]));
+  return roots;
+}
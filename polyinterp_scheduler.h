@@ -0,0 +1,292 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// Deadline-aware refit scheduling.
+//
+// Thousands of interpolators receiving points need refits, but
+// refitting each on every point bursts the CPU.  A scheduler owns
+// the interpolators instead.  Producers add(id,x,y) to a working
+// copy, which marks it dirty.  Consumers read snapshot(id), the last
+// fitted copy, published as an immutable shared pointer; a snapshot
+// never changes, and readers never wait on a fit.
+//
+// Every tick of a fixed period, the scheduler orders the dirty
+// interpolators by priority, highest first; within a priority,
+// earliest deadline first, a deadline being the time each became
+// dirty plus its maximum staleness; within a deadline, cheapest
+// first.  It takes them in that order while their estimated costs
+// fit the tick's CPU budget, and always takes at least one.  Worker
+// threads copy each working interpolator, fit the copy outside any
+// lock and publish it.  A fit costs about n^2 multiply-adds; the
+// scheduler learns the constant from the fits it times.  The first
+// tick comes a period after construction, each later one a period
+// after the one before or when its batch ends, whichever is later.
+//
+// Publication fires probe snapshot_swap(id, n) and calls any
+// observer set by on_publish().  Points added during a fit leave the
+// interpolator dirty again, timed from their arrival.  Failed fits
+// publish nothing and count in the metrics.
+
+#pragma once
+
+#include "polyinterp.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+template <typename Scalar>
+class poly_refit_scheduler {
+public:
+  typedef size_t id_type;
+  typedef poly_interpolator<Scalar> interpolator_type;
+  typedef std::shared_ptr<const interpolator_type> snapshot_type;
+  typedef std::chrono::steady_clock clock;
+  typedef std::function<void(id_type id, const snapshot_type &snapshot)>
+      publish_fn;
+
+  struct metrics {
+    size_t interpolators = 0;
+    size_t backlog = 0;   // dirty, awaiting a fit
+    size_t in_flight = 0; // fitting now
+    size_t refits = 0;
+    size_t failures = 0;
+    size_t deadline_misses = 0; // published later than their staleness
+    clock::duration max_staleness{}; // of the backlog, now
+    clock::duration max_published_staleness{};
+    double ns_per_term = 0; // fit cost per n^2, as learnt
+  };
+
+  // Runs workers threads fitting up to budget of estimated CPU time
+  // every period.
+  poly_refit_scheduler(size_t workers, clock::duration period,
+                       clock::duration budget)
+      : period(period), budget(budget) {
+    for (size_t i = 0; i < std::max<size_t>(1, workers); i++)
+      pool.emplace_back([this] { work(); });
+    ticker = std::thread([this] { tick(); });
+  }
+
+  poly_refit_scheduler(const poly_refit_scheduler &) = delete;
+  poly_refit_scheduler &operator=(const poly_refit_scheduler &) = delete;
+
+  // Abandons the backlog; finishes fits under way.
+  ~poly_refit_scheduler() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    idle.notify_all();
+    ticker.join();
+    for (std::thread &t : pool)
+      t.join();
+  }
+
+  // A new, empty interpolator that should never go unfitted for
+  // longer than max_staleness after a point arrives.  Higher
+  // priorities fit first, whatever their deadlines.
+  id_type enroll(Scalar thres, clock::duration max_staleness,
+                 int priority = 0) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.emplace_back();
+    entry &e = entries.back();
+    e.working.set_abscissa_thres(thres);
+    e.max_staleness = max_staleness;
+    e.priority = priority;
+    e.published = std::make_shared<const interpolator_type>(e.working);
+    return entries.size() - 1;
+  }
+
+  void add(id_type id, Scalar const &x, Scalar const &y) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entry &e = entries.at(id);
+    e.working.add(x, y);
+    if (!e.dirty) {
+      e.dirty = true;
+      e.since = clock::now();
+    }
+  }
+
+  // The last published fit; an empty interpolator before the first.
+  snapshot_type snapshot(id_type id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.at(id).published;
+  }
+
+  // Calls fn on a worker thread after each publication, in
+  // publication order for any one id.  Replaces any earlier fn.
+  void on_publish(publish_fn fn) {
+    std::lock_guard<std::mutex> lock(mutex);
+    observer = std::move(fn);
+  }
+
+  // Fits everything dirty, budget or no budget, and waits until
+  // nothing is dirty or fitting.
+  void flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    urgent = true;
+    wake.notify_all();
+    idle.wait(lock, [this] { return stopping || (!backlog() && !busy); });
+    urgent = false;
+  }
+
+  metrics statistics() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    metrics m = totals;
+    const clock::time_point now = clock::now();
+    m.interpolators = entries.size();
+    for (const entry &e : entries)
+      if (e.dirty) {
+        ++m.backlog;
+        m.max_staleness = std::max(m.max_staleness, now - e.since);
+      }
+    m.in_flight = busy;
+    m.ns_per_term = ns_per_term;
+    return m;
+  }
+
+private:
+  struct entry {
+    interpolator_type working;
+    snapshot_type published;
+    clock::duration max_staleness{};
+    clock::time_point since; // when dirty, since when
+    int priority = 0;
+    bool dirty = false;
+    bool fitting = false;
+  };
+
+  const clock::duration period, budget;
+  mutable std::mutex mutex;
+  std::condition_variable wake, idle;
+  std::deque<entry> entries; // stable addresses
+  std::deque<id_type> queue; // this tick's batch
+  size_t busy = 0;           // batch fits not yet done
+  bool urgent = false, stopping = false;
+  double ns_per_term = 1;
+  metrics totals;
+  publish_fn observer;
+  std::vector<std::thread> pool;
+  std::thread ticker;
+
+  bool backlog() const {
+    for (const entry &e : entries)
+      if (e.dirty && !e.fitting)
+        return true;
+    return false;
+  }
+
+  double cost(const entry &e) const {
+    const double n = double(e.working.n());
+    return ns_per_term * n * n;
+  }
+
+  void tick() {
+    std::unique_lock<std::mutex> lock(mutex);
+    clock::time_point next = clock::now() + period;
+    while (!stopping) {
+      wake.wait_until(lock, next,
+                      [this] { return stopping || (urgent && backlog()); });
+      if (stopping)
+        return;
+      next = clock::now() + period;
+
+      // Highest priority, earliest deadline, cheapest first, within
+      // budget.
+      std::vector<id_type> dirty;
+      for (id_type id = 0; id < entries.size(); id++)
+        if (entries[id].dirty && !entries[id].fitting)
+          dirty.push_back(id);
+      std::sort(dirty.begin(), dirty.end(), [this](id_type a, id_type b) {
+        const entry &ea = entries[a], &eb = entries[b];
+        if (ea.priority != eb.priority)
+          return ea.priority > eb.priority;
+        const clock::time_point da = ea.since + ea.max_staleness,
+                                db = eb.since + eb.max_staleness;
+        if (da != db)
+          return da < db;
+        return ea.working.n() < eb.working.n();
+      });
+      const double allowed =
+          std::chrono::duration<double, std::nano>(budget).count();
+      double spent = 0;
+      for (id_type id : dirty) {
+        const double c = cost(entries[id]);
+        if (!urgent && !queue.empty() && spent + c > allowed)
+          break;
+        spent += c;
+        entries[id].fitting = true;
+        queue.push_back(id);
+      }
+      busy = queue.size();
+      if (busy == 0) {
+        idle.notify_all();
+        continue;
+      }
+      wake.notify_all();
+      idle.wait(lock, [this] { return stopping || busy == 0; });
+    }
+  }
+
+  void work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+      wake.wait(lock, [this] { return stopping || !queue.empty(); });
+      if (stopping)
+        return;
+      const id_type id = queue.front();
+      queue.pop_front();
+      entry &e = entries[id];
+      auto fit = std::make_shared<interpolator_type>(e.working);
+      const clock::time_point since = e.since;
+      e.dirty = false;
+      lock.unlock();
+
+      const clock::time_point t0 = clock::now();
+      bool ok = true;
+      try {
+        fit->interpolate();
+      } catch (enum slatec_polint_status) {
+        ok = false;
+      }
+      const clock::time_point t1 = clock::now();
+
+      lock.lock();
+      const double n = double(fit->n());
+      if (n >= 16) {
+        const double t =
+            std::chrono::duration<double, std::nano>(t1 - t0).count();
+        ns_per_term += (t / (n * n) - ns_per_term) / 8;
+      }
+      if (ok) {
+        e.published = std::move(fit);
+        ++totals.refits;
+        const clock::duration staleness = t1 - since;
+        if (staleness > e.max_staleness)
+          ++totals.deadline_misses;
+        totals.max_published_staleness =
+            std::max(totals.max_published_staleness, staleness);
+        POLYINTERP_PROBE2(snapshot_swap, id, n);
+        // Still fitting, so no later fit of id overtakes this one.
+        if (observer) {
+          const publish_fn notify = observer;
+          const snapshot_type published = e.published;
+          lock.unlock();
+          notify(id, published);
+          lock.lock();
+        }
+      } else
+        ++totals.failures;
+      e.fitting = false;
+      if (--busy == 0)
+        idle.notify_all();
+    }
+  }
+};
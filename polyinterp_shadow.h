@@ -0,0 +1,214 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// Shadow-accuracy monitor.
+//
+// Fast engines trade accuracy for speed: single precision, compiled
+// code, lookup tables.  A monitor keeps watch in production.  Give
+// it every fast-path query with observe(id,x,y).  It samples a
+// configurable fraction of them and, on a background thread,
+// re-evaluates each sample using slatec_polyvl() on a reference fit
+// in double precision.  Error statistics accumulate per watched
+// interpolator.  A callback fires, on the background thread, whenever
+// the absolute error of a sample exceeds the threshold.
+//
+// Sampling costs the fast path one thread-local pseudo-random step;
+// queuing a sample costs a short lock.  The queue has a fixed
+// capacity.  Samples arriving when the queue is full go uncounted
+// but for dropped().
+
+#pragma once
+
+#include "polyinterp.h"
+
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class poly_shadow_monitor {
+public:
+  typedef size_t id_type;
+  typedef std::function<void(id_type id, double x, double fast, double ref)>
+      breach_fn;
+
+  struct stats {
+    size_t samples = 0;
+    size_t breaches = 0;
+    double max_abs_err = 0;
+    double sum_sq_err = 0;
+
+    double rms_err() const {
+      return samples == 0 ? 0 : std::sqrt(sum_sq_err / samples);
+    }
+  };
+
+  // Samples the given fraction of observations, 0 to 1, and calls
+  // breach for samples whose absolute error exceeds threshold.
+  poly_shadow_monitor(double fraction, double threshold, breach_fn breach,
+                      size_t capacity = 4096)
+      : threshold(threshold), breach(std::move(breach)), capacity(capacity) {
+    set_fraction(fraction);
+    worker = std::thread([this] { run(); });
+  }
+
+  poly_shadow_monitor(const poly_shadow_monitor &) = delete;
+  poly_shadow_monitor &operator=(const poly_shadow_monitor &) = delete;
+
+  // Drains outstanding samples before joining the worker.
+  ~poly_shadow_monitor() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    ready.notify_one();
+    worker.join();
+  }
+
+  void set_fraction(double fraction) {
+    uint64_t c = 0;
+    if (fraction >= 1)
+      c = UINT64_MAX;
+    else if (fraction > 0)
+      c = static_cast<uint64_t>(std::ldexp(fraction, 64));
+    cutoff.store(c, std::memory_order_relaxed);
+  }
+
+  // Starts watching an interpolator.  Fits the double-precision
+  // reference from its abscissae and ordinates.  Throws the fit
+  // status on failure, as interpolate() does.
+  template <typename Scalar>
+  id_type watch(const poly_interpolator<Scalar> &poly) {
+    auto ref = fit(poly);
+    std::lock_guard<std::mutex> lock(mutex);
+    refs.push_back(std::move(ref));
+    totals.emplace_back();
+    return refs.size() - 1;
+  }
+
+  // Refits the reference after the watched interpolator changes.
+  // Statistics carry on accumulating.
+  template <typename Scalar>
+  void rewatch(id_type id, const poly_interpolator<Scalar> &poly) {
+    auto ref = fit(poly);
+    std::lock_guard<std::mutex> lock(mutex);
+    refs.at(id) = std::move(ref);
+  }
+
+  // Observes fast-path result y at abscissa x.
+  void observe(id_type id, double x, double y) {
+    const uint64_t c = cutoff.load(std::memory_order_relaxed);
+    if (c != UINT64_MAX && next_random() >= c)
+      return;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (queue.size() >= capacity) {
+        dropped_samples.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      queue.push_back({id, x, y});
+    }
+    ready.notify_one();
+  }
+
+  stats statistics(id_type id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return totals.at(id);
+  }
+
+  size_t dropped() const {
+    return dropped_samples.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct reference {
+    std::vector<double> X, C;
+  };
+  struct sample {
+    id_type id;
+    double x, y;
+  };
+
+  const double threshold;
+  const breach_fn breach;
+  const size_t capacity;
+  std::atomic<uint64_t> cutoff{0};
+
+  mutable std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<sample> queue;
+  std::vector<std::shared_ptr<const reference>> refs;
+  std::vector<stats> totals;
+  bool stopping = false;
+  std::atomic<size_t> dropped_samples{0};
+  std::thread worker;
+
+  template <typename Scalar>
+  static std::shared_ptr<const reference>
+  fit(const poly_interpolator<Scalar> &poly) {
+    auto ref = std::make_shared<reference>();
+    ref->X.assign(poly.abscissae().begin(), poly.abscissae().end());
+    std::vector<double> Y(poly.ordinates().begin(), poly.ordinates().end());
+    ref->C.resize(Y.size());
+    if (!Y.empty()) {
+      enum slatec_polint_status status =
+          slatec_polint(Y.size(), ref->X.data(), Y.data(), ref->C.data());
+      if (status != slatec_polint_success)
+        throw status;
+    }
+    return ref;
+  }
+
+  // One xorshift64* generator per thread.
+  static uint64_t next_random() {
+    thread_local uint64_t s =
+        0x9e3779b97f4a7c15u ^ reinterpret_cast<uintptr_t>(&s);
+    s ^= s >> 12;
+    s ^= s << 25;
+    s ^= s >> 27;
+    return s * 0x2545f4914f6cdd1du;
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+      ready.wait(lock, [this] { return stopping || !queue.empty(); });
+      if (queue.empty())
+        return;
+      sample s = queue.front();
+      queue.pop_front();
+      if (s.id >= refs.size())
+        continue;
+      std::shared_ptr<const reference> ref = refs[s.id];
+      lock.unlock();
+
+      // An empty interpolator answers its abscissa; so does the
+      // reference.
+      double r = s.x;
+      if (!ref->X.empty())
+        slatec_polyvl(s.x, &r, ref->X.size(), ref->X.data(), ref->C.data());
+      const double err = std::fabs(s.y - r);
+      const bool breached = !(err <= threshold);
+
+      lock.lock();
+      stats &t = totals[s.id];
+      ++t.samples;
+      if (breached)
+        ++t.breaches;
+      if (err > t.max_abs_err || std::isnan(err))
+        t.max_abs_err = err;
+      t.sum_sq_err += err * err;
+      if (breached && breach) {
+        lock.unlock();
+        breach(s.id, s.x, s.y, r);
+        lock.lock();
+      }
+    }
+  }
+};
@@ -0,0 +1,82 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// Copy-on-write interpolators.
+//
+// Copying a poly_interpolator deep-copies four vectors.  Copies of a
+// poly_shared_interpolator instead share one immutable interpolator
+// by reference count: a copy costs an atomic increment and no
+// allocation.  The first add(), interpolate(), clear() or threshold
+// change through a copy that shares its storage clones it first.
+// Distribute one calibration to many consumers, by value, for free.
+//
+// Reference counts are atomic.  Distinct copies may live and die on
+// distinct threads.  As with any value, one copy must not change on
+// one thread while another thread uses that same copy.
+
+#pragma once
+
+#include "polyinterp.h"
+
+#include <atomic>
+#include <memory>
+
+template <typename Scalar>
+class poly_shared_interpolator // a unary functor
+{
+public:
+  typedef poly_interpolator<Scalar> interpolator_type;
+
+  poly_shared_interpolator() : shared(std::make_shared<interpolator_type>()) {}
+
+  explicit poly_shared_interpolator(const interpolator_type &poly)
+      : shared(std::make_shared<interpolator_type>(poly)) {}
+
+  void set_abscissa_thres(Scalar const &x) { unique().set_abscissa_thres(x); }
+
+  void add(Scalar const &x, Scalar const &y) { unique().add(x, y); }
+
+  void interpolate() { unique().interpolate(); }
+
+  Scalar operator()(const Scalar &x) const { return (*shared)(x); }
+
+  size_t n() const { return shared->n(); }
+
+  // Clearing a shared interpolator starts afresh rather than cloning
+  // what it would discard.
+  void clear() {
+    if (owner())
+      shared->clear();
+    else {
+      auto fresh = std::make_shared<interpolator_type>();
+      fresh->set_abscissa_thres(shared->abscissa_thres());
+      shared = std::move(fresh);
+    }
+  }
+
+  // The underlying interpolator, for facilities that take one by
+  // reference.
+  const interpolator_type &get() const { return *shared; }
+
+  // Does this copy share its storage with others?
+  bool sharing() const { return !owner(); }
+
+private:
+  std::shared_ptr<interpolator_type> shared;
+
+  // Sole ownership means no other copy exists to race with.  Acquire
+  // ordering pairs with the release of the last departing copy so its
+  // reads finish before writes here begin.
+  bool owner() const {
+    if (shared.use_count() != 1)
+      return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
+  }
+
+  interpolator_type &unique() {
+    if (!owner())
+      shared = std::make_shared<interpolator_type>(*shared);
+    return *shared;
+  }
+};
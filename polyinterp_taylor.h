@@ -0,0 +1,147 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// Taylor-patch evaluation cache.
+//
+// Query streams that cluster around a slowly moving operating point
+// need not pay O(n) per evaluation.  Re-centre the interpolant at the
+// operating point z: expand the Newton form into Taylor coefficients
+// a[k] = p^(k)(z)/k!, keep only the first few terms and serve every
+// query within radius r of z from that short patch.  The radius
+// bounds the discarded tail,
+//
+//   sum |a[k]| r^k for k from terms to n-1,
+//
+// below the tolerance.  A closed form starts it, each of the n - terms
+// discarded terms getting an equal share of the tolerance; a few
+// steps then widen it while the whole tail still fits.
+//
+// A query outside the radius evaluates exactly, O(n), and leaves the
+// patch where it is.  Misses keep a running centroid, the mean of the
+// current streak of consecutive misses each within twice the radius
+// of it; a hit, or a miss further out, ends the streak.  After
+// rebuild_after misses in a streak, the operating point has
+// demonstrably moved if their centroid lies over half the radius
+// from the centre, and the patch moves to the centroid: O(n^2) to
+// rebuild.  Queries jittering about the centre, however wide, hit as
+// often as they fall inside and leave the patch where it is;
+// scattered queries never move it far and cost little more than
+// polyvl().
+//
+// The bound holds in exact arithmetic; rounding in the expansion adds
+// the usual few units in the last place.  A cache mutates on lookup,
+// so keep one per thread.
+
+#pragma once
+
+#include "polyinterp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+template <typename Scalar>
+class poly_taylor_cache {
+public:
+  // Caches the interpolator's current fit, moving the patch after
+  // rebuild_after nearby misses.  Refits need a reset().
+  poly_taylor_cache(const poly_interpolator<Scalar> &poly, Scalar tolerance,
+                    size_t terms = 4, size_t rebuild_after = 8)
+      : tolerance(tolerance), terms(terms < 1 ? 1 : terms),
+        rebuild_after(rebuild_after < 1 ? 1 : rebuild_after) {
+    reset(poly);
+  }
+
+  void reset(const poly_interpolator<Scalar> &poly) {
+    X = poly.abscissae();
+    C = poly.coefficients();
+    A.clear();
+    radius = -1;
+    streak = 0;
+  }
+
+  Scalar operator()(const Scalar &x) {
+    if (X.empty())
+      return x;
+    const Scalar d = x - z;
+    if (std::fabs(d) <= radius) {
+      const Scalar *a = A.data();
+      size_t k = A.size() - 1;
+      Scalar y = a[k];
+      while (k-- > 0)
+        y = y * d + a[k];
+      ++patch_hits;
+      streak = 0;
+      return y;
+    }
+    ++patch_misses;
+    Scalar y = 0;
+    polyvl(x, &y, X.size(), X.data(), C.data());
+    // Before the first patch any misses count as near.
+    if (streak != 0 && !(radius < 0) &&
+        !(std::fabs(x - centroid) <= 2 * radius))
+      streak = 0;
+    ++streak;
+    centroid += (x - centroid) / Scalar(streak);
+    if (streak >= rebuild_after) {
+      streak = 0;
+      if (radius < 0 || !(std::fabs(centroid - z) <= radius / 2))
+        rebuild(centroid);
+    }
+    return y;
+  }
+
+  // Centre and radius of the current patch; negative radius before
+  // the first query.
+  Scalar centre() const { return z; }
+  Scalar patch_radius() const { return radius; }
+
+  size_t hits() const { return patch_hits; }
+  size_t misses() const { return patch_misses; }
+
+private:
+  const Scalar tolerance;
+  const size_t terms, rebuild_after;
+  std::vector<Scalar> X, C, A;
+  Scalar z = 0, radius = -1;
+  Scalar centroid = 0; // of the current streak of misses
+  size_t streak = 0;
+  size_t patch_hits = 0, patch_misses = 0;
+
+  // Sum of the discarded tail at radius r.
+  Scalar tail(const std::vector<Scalar> &a, Scalar r) const {
+    Scalar sum = 0;
+    for (size_t k = a.size(); k-- > terms;)
+      sum = sum * r + std::fabs(a[k]);
+    return sum * std::pow(r, Scalar(terms));
+  }
+
+  void rebuild(Scalar at) {
+    std::vector<Scalar> a =
+        poly_horner_expand(X.size(), X.data(), C.data(), at);
+    z = at;
+    radius = std::numeric_limits<Scalar>::infinity();
+    // |a[k]| r^k <= tolerance / (n - terms) for every discarded k.
+    const Scalar share = tolerance / Scalar(a.size() > terms
+                                                ? a.size() - terms
+                                                : 1);
+    for (size_t k = terms; k < a.size(); k++)
+      if (a[k] != 0)
+        radius = std::min(
+            radius, std::pow(share / std::fabs(a[k]), Scalar(1) / Scalar(k)));
+    if (!(radius >= 0))
+      radius = 0;
+    // The equal shares undersell it; widen a few steps while the
+    // whole tail still fits.
+    for (int i = 0; i < 4 && radius > 0 && std::isfinite(radius); i++) {
+      const Scalar wider = radius * Scalar(1.5);
+      if (!(tail(a, wider) <= tolerance))
+        break;
+      radius = wider;
+    }
+    if (a.size() > terms)
+      a.resize(terms);
+    A = a;
+  }
+};
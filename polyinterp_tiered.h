@@ -0,0 +1,339 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// A memory-bounded, two-tier store of fitted interpolators.
+//
+// Millions of calibrations, few of them hot: keeping every
+// poly_interpolator resident wastes memory on ordinates, merge
+// counts and the rest.  A tiered store keeps only what evaluation
+// needs, abscissae and Newton coefficients, and keeps that resident
+// for the hot few.  The cold rest live serialised in a file, written
+// by pwrite() and read back by pread() rather than mapped, so cold
+// records cost the process no resident memory; the kernel's page
+// cache keeps them as it sees fit.  Access to a cold interpolator
+// faults it back in by reading its record: no refit.
+//
+// A budget bounds the resident bytes.  The CLOCK policy picks what
+// to evict: resident interpolators sit on a ring, each with a
+// reference bit set on access; the hand sweeps the ring, clearing
+// set bits and evicting the first interpolator found clear.  Records
+// never change once written, so an interpolator evicted a second
+// time costs nothing to write.  Replacing an interpolator orphans its
+// old record; the file does not compact.
+//
+// Evaluators handed out by acquire() are shared.  Evicting one frees
+// its memory only once its last user lets go, so the budget holds
+// for the store's own references.  The budget covers evaluators
+// only: every id, hot or cold, also keeps a small entry resident,
+// reported as metadata_bytes.
+//
+// Hits on resident interpolators share the store's lock, setting
+// their reference bits atomically, so readers never wait on one
+// another; faults, insertions, replacements and evictions take it
+// exclusively.  An operation that throws leaves the store as it
+// found it, but for interpolators already evicted on its behalf.
+
+#pragma once
+
+#include "polyinterp.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+enum poly_tiered_status {
+  poly_tiered_success,
+  poly_tiered_io_error = -1,
+  poly_tiered_no_such_id = -2
+};
+
+template <typename Scalar>
+class poly_tiered_store {
+public:
+  typedef size_t id_type;
+
+  // The resident form: what polyvl() needs and nothing more.
+  struct evaluator {
+    std::vector<Scalar> X, C;
+
+    Scalar operator()(const Scalar &x) const {
+      if (X.empty())
+        return x;
+      Scalar y = 0;
+      polyvl(x, &y, X.size(), X.data(), C.data());
+      return y;
+    }
+
+    size_t n() const { return X.size(); }
+  };
+
+  struct stats {
+    size_t interpolators = 0;
+    size_t resident = 0;       // interpolators in memory
+    size_t resident_bytes = 0; // their footprint, as budgeted
+    size_t cold_bytes = 0;     // file bytes, orphans included
+    size_t metadata_bytes = 0; // per-id bookkeeping, outside the budget
+    size_t hits = 0, misses = 0, evictions = 0;
+  };
+
+  // Keeps at most budget bytes resident, and the rest in a file at
+  // path, or in an anonymous temporary file given none.  Throws
+  // poly_tiered_io_error if the file will not open.
+  explicit poly_tiered_store(size_t budget, const char *path = nullptr)
+      : budget(budget),
+        file(path ? std::fopen(path, "w+b") : std::tmpfile()) {
+    if (file == nullptr)
+      throw poly_tiered_io_error;
+  }
+
+  poly_tiered_store(const poly_tiered_store &) = delete;
+  poly_tiered_store &operator=(const poly_tiered_store &) = delete;
+
+  ~poly_tiered_store() { std::fclose(file); }
+
+  // Stores the fit of poly from its last interpolate().
+  id_type insert(const poly_interpolator<Scalar> &poly) {
+    auto fresh = compact(poly);
+    std::lock_guard<std::shared_mutex> lock(mutex);
+    entries.emplace_back();
+    const id_type id = entries.size() - 1;
+    try {
+      admit(id, std::move(fresh));
+    } catch (...) {
+      entries.pop_back();
+      throw;
+    }
+    return id;
+  }
+
+  void replace(id_type id, const poly_interpolator<Scalar> &poly) {
+    auto fresh = compact(poly);
+    std::lock_guard<std::shared_mutex> lock(mutex);
+    entry &e = at(id);
+    const std::shared_ptr<const evaluator> old = e.hot;
+    const size_t offset = e.offset;
+    if (e.hot)
+      release(id);
+    e.offset = none;
+    try {
+      admit(id, std::move(fresh));
+    } catch (...) {
+      // Back into the slot just freed: no allocation, no eviction.
+      e.offset = offset;
+      if (old)
+        place(id, old);
+      throw;
+    }
+  }
+
+  // The resident evaluator of id, faulting it in if cold.  Throws
+  // poly_tiered_no_such_id, or poly_tiered_io_error when the fault
+  // cannot read its record or an eviction it forces cannot write one.
+  std::shared_ptr<const evaluator> acquire(id_type id) {
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex);
+      const entry &e = at(id);
+      if (e.hot) {
+        hit(e);
+        return e.hot;
+      }
+    }
+    std::lock_guard<std::shared_mutex> lock(mutex);
+    entry &e = entries[id];
+    if (e.hot) { // faulted in meanwhile
+      hit(e);
+      return e.hot;
+    }
+    ++totals.misses;
+    auto fresh = std::make_shared<evaluator>();
+    uint64_t n;
+    read_at(&n, sizeof n, e.offset);
+    fresh->X.resize(n);
+    fresh->C.resize(n);
+    read_at(fresh->X.data(), n * sizeof(Scalar), e.offset + sizeof n);
+    read_at(fresh->C.data(), n * sizeof(Scalar),
+            e.offset + sizeof n + n * sizeof(Scalar));
+    admit(id, fresh);
+    return fresh;
+  }
+
+  Scalar operator()(id_type id, const Scalar &x) { return (*acquire(id))(x); }
+
+  stats statistics() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    stats s = totals;
+    s.hits = hits.load(std::memory_order_relaxed);
+    s.interpolators = entries.size();
+    s.resident = resident;
+    s.resident_bytes = resident_bytes;
+    s.cold_bytes = used;
+    s.metadata_bytes = entries.capacity() * sizeof(entry) +
+                       ring.capacity() * sizeof(id_type) +
+                       free_slots.capacity() * sizeof(size_t);
+    return s;
+  }
+
+private:
+  static constexpr size_t none = SIZE_MAX;
+
+  struct entry {
+    std::shared_ptr<const evaluator> hot; // null when cold
+    size_t offset = none;                 // record in the file, if any
+    size_t slot = none;                   // place on the ring, if hot
+    mutable std::atomic<bool> referenced{false}; // set by shared hits
+
+    entry() = default;
+    // Moved only as the table grows, under the exclusive lock.
+    entry(entry &&other) noexcept
+        : hot(std::move(other.hot)), offset(other.offset), slot(other.slot),
+          referenced(other.referenced.load(std::memory_order_relaxed)) {}
+  };
+
+  const size_t budget;
+  std::FILE *const file;
+  mutable std::shared_mutex mutex;
+  std::vector<entry> entries;
+  std::vector<id_type> ring; // hot ids, or none for free slots
+  std::vector<size_t> free_slots;
+  size_t hand = 0;
+  size_t resident = 0, resident_bytes = 0;
+  size_t used = 0; // file bytes written
+  stats totals;
+  mutable std::atomic<size_t> hits{0}; // counted under the shared lock
+
+  entry &at(id_type id) {
+    if (id >= entries.size())
+      throw poly_tiered_no_such_id;
+    return entries[id];
+  }
+
+  // Counts a hit on resident e, under either lock.  Writes the shared
+  // reference bit only when clear.
+  void hit(const entry &e) const {
+    hits.fetch_add(1, std::memory_order_relaxed);
+    if (!e.referenced.load(std::memory_order_relaxed))
+      e.referenced.store(true, std::memory_order_relaxed);
+  }
+
+  static std::shared_ptr<const evaluator>
+  compact(const poly_interpolator<Scalar> &poly) {
+    auto e = std::make_shared<evaluator>();
+    e->X = poly.abscissae();
+    e->C = poly.coefficients();
+    e->X.shrink_to_fit();
+    e->C.shrink_to_fit();
+    return e;
+  }
+
+  static size_t footprint(const evaluator &e) {
+    return sizeof(evaluator) + 2 * e.n() * sizeof(Scalar);
+  }
+
+  // Makes id resident, then evicts others until within budget.  If
+  // an eviction throws, id goes back to cold first.
+  void admit(id_type id, std::shared_ptr<const evaluator> hot) {
+    place(id, std::move(hot));
+    try {
+      evict(id);
+    } catch (...) {
+      release(id);
+      throw;
+    }
+  }
+
+  // Makes id resident, over budget or not.  Allocates, if at all,
+  // before changing anything: room for every slot to come free too,
+  // so that release() never allocates.
+  void place(id_type id, std::shared_ptr<const evaluator> hot) {
+    entry &e = entries[id];
+    if (free_slots.empty()) {
+      free_slots.reserve(ring.size() + 1);
+      e.slot = ring.size();
+      ring.push_back(id);
+    } else {
+      e.slot = free_slots.back();
+      free_slots.pop_back();
+      ring[e.slot] = id;
+    }
+    resident_bytes += footprint(*hot);
+    ++resident;
+    e.hot = std::move(hot);
+    e.referenced.store(true, std::memory_order_relaxed);
+  }
+
+  // Evicts others than id until within budget.
+  void evict(id_type id) {
+    while (resident_bytes > budget && resident > 1) {
+      hand = hand + 1 < ring.size() ? hand + 1 : 0;
+      const id_type victim = ring[hand];
+      if (victim == none || victim == id)
+        continue;
+      entry &v = entries[victim];
+      if (v.referenced.load(std::memory_order_relaxed)) {
+        v.referenced.store(false, std::memory_order_relaxed);
+        continue;
+      }
+      if (v.offset == none)
+        v.offset = write(*v.hot);
+      release(victim);
+      ++totals.evictions;
+    }
+  }
+
+  void release(id_type id) {
+    entry &e = entries[id];
+    resident_bytes -= footprint(*e.hot);
+    --resident;
+    e.hot.reset();
+    ring[e.slot] = none;
+    free_slots.push_back(e.slot);
+    e.slot = none;
+  }
+
+  // Appends a record, n then X then C.  Answers its offset.
+  size_t write(const evaluator &e) {
+    const uint64_t n = e.n();
+    const size_t offset = used;
+    write_at(&n, sizeof n, offset);
+    write_at(e.X.data(), n * sizeof(Scalar), offset + sizeof n);
+    write_at(e.C.data(), n * sizeof(Scalar),
+             offset + sizeof n + n * sizeof(Scalar));
+    used += sizeof n + 2 * n * sizeof(Scalar);
+    return offset;
+  }
+
+  void write_at(const void *p, size_t bytes, size_t offset) {
+    const char *q = static_cast<const char *>(p);
+    while (bytes != 0) {
+      const ssize_t k = pwrite(fileno(file), q, bytes, off_t(offset));
+      if (k < 0 && errno == EINTR)
+        continue;
+      if (k <= 0)
+        throw poly_tiered_io_error;
+      q += k;
+      bytes -= size_t(k);
+      offset += size_t(k);
+    }
+  }
+
+  void read_at(void *p, size_t bytes, size_t offset) const {
+    char *q = static_cast<char *>(p);
+    while (bytes != 0) {
+      const ssize_t k = pread(fileno(file), q, bytes, off_t(offset));
+      if (k < 0 && errno == EINTR)
+        continue;
+      if (k <= 0)
+        throw poly_tiered_io_error;
+      q += k;
+      bytes -= size_t(k);
+      offset += size_t(k);
+    }
+  }
+};
@@ -0,0 +1,149 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// A polynomial interpolator over integer timestamps.
+//
+// Operation add(t,y) adds point (t,y) where t counts integer ticks,
+// nanoseconds since some epoch say.  Sixty-four-bit tick counts do
+// not survive conversion to double, let alone float.  Abscissae
+// therefore stay integral: offsets from an anchor, the first
+// timestamp added.  Merging works in ticks too.  Points closer than
+// the threshold merge at their exact arithmetic mean, held as a
+// whole number of ticks plus a remainder.
+//
+// Fitting and evaluation convert each offset to a centred, scaled
+// Scalar
+//
+//   u = (t - centre) * scale
+//
+// mapping the fitted range onto [-1, 1].  Integer subtraction comes
+// first, exactly; only the small centred difference meets floating
+// point.  Single precision serves for spans the float mantissa can
+// resolve, whatever the epoch.
+
+#pragma once
+
+#include "polyinterp.h"
+
+#include <cstdint>
+#include <vector>
+
+template <typename Scalar>
+struct poly_timestamp_interpolator // a unary functor
+{
+  typedef int64_t tick_type;
+
+private:
+  tick_type abscissaDeltaThres;
+  tick_type anchor_;
+  // Offsets from the anchor: whole-tick means T and remainders R of
+  // the merged sums; the exact mean is T + R/N.
+  std::vector<tick_type> T, R;
+  std::vector<Scalar> U, Y, C;
+  std::vector<int> N;
+  tick_type centre;
+  Scalar scale;
+
+  // Merges offset d into point i, exactly.
+  void merge(size_t i, tick_type d, Scalar const &y) {
+    tick_type r = R[i] + (d - T[i]);
+    tick_type m = N[i] + 1;
+    tick_type q = r / m;
+    r %= m;
+    if (r < 0)
+      --q, r += m;
+    T[i] += q;
+    R[i] = r;
+    Y[i] = (y + Y[i] * N[i]) / (N[i] + 1);
+    ++N[i];
+  }
+
+public:
+  poly_timestamp_interpolator()
+      : abscissaDeltaThres(0), anchor_(0), centre(0), scale(1) {}
+
+  void set_abscissa_thres(tick_type const &ticks) {
+    if (0 <= ticks)
+      abscissaDeltaThres = ticks;
+  }
+
+  tick_type abscissa_thres() const { return abscissaDeltaThres; }
+
+  // Timestamp of the first point added since construction or clear().
+  tick_type anchor() const { return anchor_; }
+
+  void add(tick_type const &t, Scalar const &y) {
+    if (N.empty())
+      anchor_ = t;
+    const tick_type d = t - anchor_;
+    auto Ti = T.begin();
+    for (; Ti != T.end() && *Ti < d; ++Ti)
+      ;
+    auto i = std::distance(T.begin(), Ti);
+    // Against the exact means T + R/N, 0 <= R < N: d exceeds its left
+    // neighbour's by at most the threshold iff it exceeds T by at most
+    // the threshold; its right neighbour's exceeds d by at most the
+    // threshold iff T does, by one tick less when R is nonzero.
+    if (Ti != T.begin() && d - Ti[-1] <= abscissaDeltaThres)
+      merge(i - 1, d, y);
+    else if (Ti != T.end() &&
+             Ti[0] - d <= abscissaDeltaThres - (R[i] != 0 ? 1 : 0))
+      merge(i, d, y);
+    else {
+      T.reserve(N.size() + 1);
+      R.reserve(N.size() + 1);
+      U.reserve(N.size() + 1);
+      Y.reserve(N.size() + 1);
+      C.reserve(N.size() + 1);
+      N.reserve(N.size() + 1);
+
+      T.insert(T.begin() + i, d);
+      R.insert(R.begin() + i, 0);
+      U.insert(U.begin() + i, 0);
+      Y.insert(Y.begin() + i, y);
+      C.insert(C.begin() + i, 0);
+      N.insert(N.begin() + i, 1);
+    }
+  }
+
+  void interpolate() {
+    if (!N.empty()) {
+      const tick_type lo = T.front(), hi = T.back();
+      centre = lo + (hi - lo) / 2;
+      scale = hi == lo ? Scalar(1) : Scalar(2) / Scalar(hi - lo);
+      for (size_t i = 0; i < N.size(); i++)
+        U[i] = (Scalar(T[i] - centre) + Scalar(R[i]) / Scalar(N[i])) * scale;
+    }
+    enum slatec_polint_status status =
+        polint(N.size(), U.data(), Y.data(), C.data());
+    if (status != slatec_polint_success)
+      throw status;
+  }
+
+  // Centred, scaled abscissa of timestamp t as the kernels see it.
+  Scalar offset(tick_type const &t) const {
+    return Scalar(t - anchor_ - centre) * scale;
+  }
+
+  Scalar operator()(const tick_type &t) const {
+    if (N.size() == 0)
+      return Scalar(t);
+    Scalar y;
+    enum slatec_polyvl_status status =
+        polyvl(offset(t), &y, N.size(), U.data(), C.data());
+    if (status != slatec_polyvl_success)
+      throw status;
+    return y;
+  }
+
+  size_t n() const { return N.size(); }
+
+  void clear() {
+    T.clear();
+    R.clear();
+    U.clear();
+    Y.clear();
+    C.clear();
+    N.clear();
+  }
+};
@@ -0,0 +1,90 @@
+// -*- c++ -*-
+// SPDX-License-Identifier: MIT
+//
+// Statically defined tracing probes.
+//
+// POLYINTERP_PROBE1(name,a) through POLYINTERP_PROBE3(name,a,b,c)
+// mark user-space statically defined tracing (USDT) points under
+// provider "polyinterp".  Each compiles to a single nop plus an ELF
+// note that tells perf, bpftrace and SystemTap where the nop lives
+// and where to find its arguments.  Until a tracer attaches and
+// patches in a breakpoint, the probe costs nothing but its nop.
+//
+//   bpftrace -e 'usdt:./polyinterp:polyinterp:interpolate_entry
+//                { @[arg1] = count(); }'
+//
+// Probes use <sys/sdt.h> when the system has it.  Otherwise, on
+// x86-64 ELF targets, they emit the same note format directly.
+// Elsewhere, or given POLYINTERP_NO_PROBES, they vanish.  Arguments
+// all pass as 64-bit integers; pointers identify instances.
+
+#pragma once
+
+#include <stdint.h>
+
+#if defined(POLYINTERP_NO_PROBES)
+#define POLYINTERP_PROBES 0
+#elif defined(__has_include) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define POLYINTERP_PROBES 1
+#elif defined(__x86_64__) && defined(__ELF__) && defined(__GNUC__)
+#define POLYINTERP_PROBES 2
+#else
+#define POLYINTERP_PROBES 0
+#endif
+
+#if POLYINTERP_PROBES == 1
+
+#define POLYINTERP_PROBE1(name, a)                                             \
+  DTRACE_PROBE1(polyinterp, name, (uint64_t)(a))
+#define POLYINTERP_PROBE2(name, a, b)                                          \
+  DTRACE_PROBE2(polyinterp, name, (uint64_t)(a), (uint64_t)(b))
+#define POLYINTERP_PROBE3(name, a, b, c)                                       \
+  DTRACE_PROBE3(polyinterp, name, (uint64_t)(a), (uint64_t)(b), (uint64_t)(c))
+
+#elif POLYINTERP_PROBES == 2
+
+// The stapsdt note: probe address, base address for prelink
+// adjustment, no semaphore, then provider, name and argument
+// descriptions "8@operand" for unsigned 64-bit arguments.
+#define POLYINTERP_SDT(name, args, ...)                                        \
+  __asm__ __volatile__(                                                        \
+      "990: nop\n"                                                             \
+      ".pushsection .note.stapsdt,\"?\",\"note\"\n"                            \
+      ".balign 4\n"                                                            \
+      ".4byte 992f-991f, 994f-993f, 3\n"                                       \
+      "991: .asciz \"stapsdt\"\n"                                              \
+      "992: .balign 4\n"                                                       \
+      "993: .8byte 990b\n"                                                     \
+      ".8byte _.stapsdt.base\n"                                                \
+      ".8byte 0\n"                                                             \
+      ".asciz \"polyinterp\"\n"                                                \
+      ".asciz \"" #name "\"\n"                                                 \
+      ".asciz \"" args "\"\n"                                                  \
+      "994: .balign 4\n"                                                       \
+      ".popsection\n"                                                          \
+      ".ifndef _.stapsdt.base\n"                                               \
+      ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"  \
+      ".weak _.stapsdt.base\n"                                                 \
+      ".hidden _.stapsdt.base\n"                                               \
+      "_.stapsdt.base: .space 1\n"                                             \
+      ".size _.stapsdt.base, 1\n"                                              \
+      ".popsection\n"                                                          \
+      ".endif\n" ::__VA_ARGS__)
+
+#define POLYINTERP_PROBE1(name, a)                                             \
+  POLYINTERP_SDT(name, "8@%0", "nor"((uint64_t)(a)))
+#define POLYINTERP_PROBE2(name, a, b)                                          \
+  POLYINTERP_SDT(name, "8@%0 8@%1", "nor"((uint64_t)(a)),                      \
+                 "nor"((uint64_t)(b)))
+#define POLYINTERP_PROBE3(name, a, b, c)                                       \
+  POLYINTERP_SDT(name, "8@%0 8@%1 8@%2", "nor"((uint64_t)(a)),                 \
+                 "nor"((uint64_t)(b)), "nor"((uint64_t)(c)))
+
+#else
+
+#define POLYINTERP_PROBE1(name, a) ((void)0)
+#define POLYINTERP_PROBE2(name, a, b) ((void)0)
+#define POLYINTERP_PROBE3(name, a, b, c) ((void)0)
+
+#endif